@@ -0,0 +1,605 @@
+#include "simple_safedata.h"
+
+#include <time.h>
+
+/* Note:
+ *    Benchmark for simple bitmap and the sfd macros
+ *
+ *    Build it twice to see the overhead of sfd against plain C:
+ *       gcc -O2 -o bench bench.c simple_bitmap.c randport.c
+ *       gcc -O2 -DSIMPLE_SAFEDATA_DISABLE -o bench_nosfd bench.c simple_bitmap.c randport.c
+ *
+ *    Usage:
+ *       ./bench [max size in bits] [threads]
+ *
+ *    threads is only read when built with -DSIMPLE_BITMAP_PARALLEL -pthread,
+ *    and sets the size of the thread pool used by the bulk functions(4 by default)
+ *
+ *    sizes go from 64 bits up to max size(1G bits by default) by a factor of 16
+ *    each measurement is repeated until it takes at least BENCH_MIN_TIME seconds
+ *
+ *    ns/op is the time of one call, GB/s is computed from the bytes of map data
+ *    the call has to go through, "-" is shown when that does not apply
+ */
+
+#define BENCH_MIN_SIZE        64
+#define BENCH_MAX_SIZE        (1UL << 30)
+#define BENCH_SIZE_STEP       16
+#define BENCH_MIN_TIME        0.1
+#define BENCH_INDEX_NUM       4096     // must be a power of 2
+#define BENCH_SFD_MAX_SIZE    (1UL << 26) // sfd arrays are arrays of int, not bits
+#define BENCH_THREADS         4
+
+static volatile unsigned long bench_sink;
+
+static uint_fast32_t bench_index[BENCH_INDEX_NUM];
+
+static map_block bench_value[BENCH_INDEX_NUM];
+
+static map_block bench_result[BENCH_INDEX_NUM];
+
+static bit_index bench_out[BENCH_INDEX_NUM];
+
+static unsigned long bench_rand_state = 12345;
+
+static unsigned long bench_rand () {
+   bench_rand_state = bench_rand_state * 6364136223846793005UL + 1442695040888963407UL;
+   return bench_rand_state >> 17;
+}
+
+// wall clock time in seconds, clock() would add up the time of all threads
+static double bench_time () {
+   struct timespec ts;
+
+   timespec_get(&ts, TIME_UTC);
+
+   return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void bench_report (const char* label, unsigned long size, unsigned long ops, double seconds, double bytes_per_op) {
+   double ns = seconds * 1e9 / ops;
+
+   if (bytes_per_op > 0) {
+      printf("%-32s %12lu %14.2f %10.3f\n", label, size, ns, bytes_per_op / ns);
+   }
+   else {
+      printf("%-32s %12lu %14.2f %10s\n", label, size, ns, "-");
+   }
+}
+
+// runs body repeatedly, doubling the repetitions until it takes long enough
+// body performs ops_per_rep operations each time
+#define bench_run_n(label, size, ops_per_rep, bytes_per_op, body) \
+   do {\
+      unsigned long bench_reps = 1;\
+      unsigned long r;\
+      double bench_t0;\
+      double bench_t;\
+      for (;;) {\
+         bench_t0 = bench_time();\
+         for (r = 0; r < bench_reps; r++) {\
+            body;\
+         }\
+         bench_t = bench_time() - bench_t0;\
+         if (bench_t >= BENCH_MIN_TIME) {\
+            break;\
+         }\
+         bench_reps *= 2;\
+      }\
+      bench_report(label, size, bench_reps * (ops_per_rep), bench_t, bytes_per_op);\
+   } while (0)
+
+#define bench_run(label, size, bytes_per_op, body) \
+   bench_run_n(label, size, 1, bytes_per_op, body)
+
+static int bench_one_callback (bit_index index, void* arg) {
+   (void) arg;
+
+   bench_sink += index;
+
+   return 0;
+}
+
+static void bench_fill_index (unsigned long size) {
+   int i;
+   for (i = 0; i < BENCH_INDEX_NUM; i++) {
+      bench_index[i] = bench_rand() % size;
+      bench_value[i] = bench_rand() & 0x1;
+   }
+}
+
+static map_block* bench_alloc_map (simple_bitmap* map, unsigned long size, map_block default_value) {
+   map_block* base = (map_block*) malloc(sizeof(map_block) * get_bitmap_map_block_number(size));
+
+   if (base == NULL) {
+      printf("bench : malloc failed for %lu bits\n", size);
+      exit(1);
+   }
+
+   bitmap_init(map, base, NULL, size, default_value);
+
+   return base;
+}
+
+// searches with no match must report SEARCH_FAIL rather than an index past the end,
+// checked once before timing anything, as the timings would mean nothing otherwise
+// size is deliberately not a multiple of any map block size
+#define BENCH_CHECK_SIZE      1001
+
+static int bench_check_search () {
+   simple_bitmap ones;
+   simple_bitmap zeros;
+
+   map_block* base1;
+   map_block* base2;
+
+   uint_fast32_t index_result;
+
+   int failed = 0;
+
+   base1 = bench_alloc_map(&ones, BENCH_CHECK_SIZE, 1);
+   base2 = bench_alloc_map(&zeros, BENCH_CHECK_SIZE, 0);
+
+   if (bitmap_first_zero_bit_index(&ones, &index_result, 0) != SEARCH_FAIL
+       || bitmap_first_zero_bit_index_back(&ones, &index_result, BENCH_CHECK_SIZE - 1) != SEARCH_FAIL
+       || bitmap_first_one_bit_index(&zeros, &index_result, 0) != SEARCH_FAIL
+       || bitmap_first_one_bit_index_back(&zeros, &index_result, BENCH_CHECK_SIZE - 1) != SEARCH_FAIL) {
+      printf("bench : search without a match did not report SEARCH_FAIL\n");
+      failed = 1;
+   }
+
+   if (bitmap_first_one_bit_index_back(&ones, &index_result, BENCH_CHECK_SIZE - 1) != 0
+       || index_result != BENCH_CHECK_SIZE - 1
+       || bitmap_first_zero_bit_index(&zeros, &index_result, BENCH_CHECK_SIZE - 1) != 0
+       || index_result != BENCH_CHECK_SIZE - 1) {
+      printf("bench : search with a match at the last bit failed\n");
+      failed = 1;
+   }
+
+   free(base1);
+   free(base2);
+
+   return failed;
+}
+
+static void bench_bitmap (unsigned long size) {
+   simple_bitmap map1;
+   simple_bitmap map2;
+   simple_bitmap map3;
+
+   map_block* base1;
+   map_block* base2;
+   map_block* base3;
+
+   map_block result;
+
+   bit_index index_result;
+
+   bitmap_cont_group grp;
+
+   bitmap_cont_group_iter iter;
+
+   simple_growable_bitmap gmap;
+
+   bitmap_handle handle;
+
+   simple_sparse_bitmap sparse;
+
+   bit_index* rank;
+
+   bit_index count;
+
+   unsigned char verdict;
+
+   simple_bitmap map4;
+
+   map_block* base4;
+
+   simple_bitmap* expr_maps[4];
+
+   bitmap_expr_op expr[7] = {
+      {BITMAP_EXPR_PUSH, 0}, {BITMAP_EXPR_PUSH, 1}, {BITMAP_EXPR_AND, 0},
+      {BITMAP_EXPR_PUSH, 2}, {BITMAP_EXPR_ANDNOT, 0}, {BITMAP_EXPR_PUSH, 3}, {BITMAP_EXPR_OR, 0}
+   };
+
+   double bytes = (double) get_bitmap_map_block_number(size) * sizeof(map_block);
+
+   unsigned long i;
+
+   base1 = bench_alloc_map(&map1, size, 0);
+   base2 = bench_alloc_map(&map2, size, 0);
+   base3 = bench_alloc_map(&map3, size, 0);
+   base4 = bench_alloc_map(&map4, size, 0);
+
+   expr_maps[0] = &map1;
+   expr_maps[1] = &map2;
+   expr_maps[2] = &map3;
+   expr_maps[3] = &map1;
+
+   bench_fill_index(size);
+
+   for (i = 0; i < size; i += 3) {
+      bitmap_write(&map2, i, 1, 0);
+   }
+
+   bench_run("bitmap_read (random)", size, 0,
+      bitmap_read(&map2, bench_index[r & (BENCH_INDEX_NUM - 1)], &result, 0);
+      bench_sink += result;
+   );
+   bench_run("bitmap_write (random)", size, 0,
+      bitmap_write(&map1, bench_index[r & (BENCH_INDEX_NUM - 1)], r & 0x1, 0)
+   );
+
+   // one op is one bit, the meta data is decrypted once for the whole loop or batch
+   bitmap_meta_unlock(&map1);
+   bench_run_n("bitmap_write (random, unlocked)", size, BENCH_INDEX_NUM, 0,
+      for (i = 0; i < BENCH_INDEX_NUM; i++) {
+         bitmap_write(&map1, bench_index[i], bench_value[i], 0);
+      }
+   );
+   bitmap_meta_relock(&map1);
+   bench_run_n("bitmap_read_batch (random)", size, BENCH_INDEX_NUM, 0,
+      bitmap_read_batch(&map2, bench_index, BENCH_INDEX_NUM, bench_result, 0);
+      bench_sink += bench_result[r & (BENCH_INDEX_NUM - 1)];
+   );
+   bench_run_n("bitmap_write_batch (random)", size, BENCH_INDEX_NUM, 0,
+      bitmap_write_batch(&map1, bench_index, BENCH_INDEX_NUM, bench_value, 0)
+   );
+
+   bitmap_checkout(&map1, &handle);
+   bench_run("bitmap_handle_read (random)", size, 0,
+      bench_sink += bitmap_handle_read(&handle, bench_index[r & (BENCH_INDEX_NUM - 1)])
+   );
+   bench_run("bitmap_handle_write (random)", size, 0,
+      bitmap_handle_write(&handle, bench_index[r & (BENCH_INDEX_NUM - 1)], r & 0x1)
+   );
+   bitmap_release(&handle);
+
+   bitmap_sparse_init(&sparse, size, 0);
+   bench_run("bitmap_sparse_write (random)", size, 0,
+      bitmap_sparse_write(&sparse, bench_index[r & (BENCH_INDEX_NUM - 1)], r & 0x1)
+   );
+   bench_run("bitmap_sparse_read (random)", size, 0,
+      bench_sink += bitmap_sparse_test(&sparse, bench_index[r & (BENCH_INDEX_NUM - 1)])
+   );
+   bitmap_sparse_free(&sparse);
+
+   // single bit set at the far end from where the search starts, so the whole map is scanned
+   bitmap_zero(&map1);
+   bitmap_write(&map1, size - 1, 1, 0);
+   bench_run("bitmap_first_one_bit_index", size, bytes,
+      bitmap_first_one_bit_index(&map1, &index_result, 0);
+      bench_sink += index_result;
+   );
+   bench_run("bitmap_first_one_cont_group", size, bytes,
+      bitmap_first_one_cont_group(&map1, &grp, 0);
+      bench_sink += grp.start;
+   );
+
+   bitmap_one(&map1);
+   bitmap_write(&map1, size - 1, 0, 0);
+   bench_run("bitmap_first_zero_bit_index", size, bytes,
+      bitmap_first_zero_bit_index(&map1, &index_result, 0);
+      bench_sink += index_result;
+   );
+
+   bitmap_zero(&map1);
+   bitmap_write(&map1, 0, 1, 0);
+   bench_run("bitmap_first_one_bit_index_back", size, bytes,
+      bitmap_first_one_bit_index_back(&map1, &index_result, size - 1);
+      bench_sink += index_result;
+   );
+   bench_run("bitmap_first_one_cont_group_back", size, bytes,
+      bitmap_first_one_cont_group_back(&map1, &grp, size - 1);
+      bench_sink += grp.start;
+   );
+
+   // every third bit of map2 is set, so there are size / 3 groups of zeros
+   bench_run("bitmap_first_zero_cont_group (all)", size, bytes,
+      for (index_result = 0;
+           bitmap_first_zero_cont_group(&map2, &grp, index_result) == 0 && grp.start + grp.length < size;
+           index_result = grp.start + grp.length) {
+         bench_sink += grp.length;
+      }
+   );
+   bench_run("bitmap_cont_group_iter (all)", size, bytes,
+      bitmap_cont_group_iter_init(&map2, &iter, 0, 0, 0);
+      while (bitmap_cont_group_iter_next(&iter, &grp) == 0) {
+         bench_sink += grp.length;
+      }
+   );
+
+   // every third bit of map2 is set, so each pass yields size / 3 indices
+   bench_run("bitmap_first_one_bit_index (all)", size, bytes,
+      for (index_result = 0;
+           index_result < size && bitmap_first_one_bit_index(&map2, &index_result, index_result) == 0;
+           index_result++) {
+         bench_sink += index_result;
+      }
+   );
+   bench_run("bitmap_for_each_one (all)", size, bytes,
+      bitmap_for_each_one(&map2, 0, size - 1, bench_one_callback, NULL)
+   );
+   bench_run("bitmap_to_indices (all)", size, bytes,
+      for (index_result = 0;
+           bitmap_to_indices(&map2, index_result, bench_out, BENCH_INDEX_NUM, &count) == 0 && count == BENCH_INDEX_NUM;
+           index_result = bench_out[count - 1] + 1) {
+         bench_sink += count;
+      }
+   );
+
+   bench_run("bitmap_count_zeros_and_ones", size, bytes,
+      bitmap_count_zeros_and_ones(&map2)
+   );
+
+   bench_run("bitmap_rank (random, no index)", size, 0,
+      bitmap_rank(&map2, bench_index[r & (BENCH_INDEX_NUM - 1)], &index_result);
+      bench_sink += index_result;
+   );
+   rank = (bit_index*) malloc(sizeof(bit_index) * get_bitmap_rank_entry_number(size));
+   if (rank == NULL) {
+      printf("bench : malloc failed for rank index\n");
+      exit(1);
+   }
+   bitmap_rank_attach(&map2, rank, 0);
+   bench_run("bitmap_rank (random)", size, 0,
+      bitmap_rank(&map2, bench_index[r & (BENCH_INDEX_NUM - 1)], &index_result);
+      bench_sink += index_result;
+   );
+   bench_run("bitmap_select (random)", size, 0,
+      bitmap_select(&map2, bench_index[r & (BENCH_INDEX_NUM - 1)] / 3, &index_result);
+      bench_sink += index_result;
+   );
+   bitmap_rank_detach(&map2);
+   free(rank);
+
+   bench_run("bitmap_zero", size, bytes,
+      bitmap_zero(&map3)
+   );
+   bench_run("bitmap_not", size, 2 * bytes,
+      bitmap_not(&map3)
+   );
+
+   bench_run("bitmap_and", size, 3 * bytes,
+      bitmap_and(&map1, &map2, &map3, 1)
+   );
+   bench_run("bitmap_or", size, 3 * bytes,
+      bitmap_or(&map1, &map2, &map3, 1)
+   );
+   bench_run("bitmap_xor", size, 3 * bytes,
+      bitmap_xor(&map1, &map2, &map3, 1)
+   );
+
+   bench_run("bitmap_and_count", size, 2 * bytes,
+      bitmap_and_count(&map1, &map2, &index_result);
+      bench_sink += index_result;
+   );
+   bench_run("bitmap_xor_count", size, 2 * bytes,
+      bitmap_xor_count(&map1, &map2, &index_result);
+      bench_sink += index_result;
+   );
+   // equal maps in separate memory, so both predicates go through the whole map
+   bitmap_copy(&map2, &map4, 0, 0);
+   bench_run("bitmap_equal (equal maps)", size, 2 * bytes,
+      bitmap_equal(&map2, &map4, &verdict);
+      bench_sink += verdict;
+   );
+   bench_run("bitmap_is_subset (equal maps)", size, 2 * bytes,
+      bitmap_is_subset(&map2, &map4, &verdict);
+      bench_sink += verdict;
+   );
+   bench_run("bitmap_intersects", size, 0,
+      bitmap_intersects(&map1, &map2, &verdict);
+      bench_sink += verdict;
+   );
+
+   // (a & b & ~c) | d over 4 inputs, once as a chain of pairwise ops and once fused
+   bench_run("pairwise (a & b & ~c) | d", size, 10 * bytes,
+      bitmap_and(&map1, &map2, &map4, 1);
+      bitmap_not(&map3);
+      bitmap_and(&map4, &map3, &map4, 1);
+      bitmap_not(&map3);
+      bitmap_or(&map4, &map1, &map4, 1)
+   );
+   bench_run("bitmap_expr_eval (a & b & ~c) | d", size, 5 * bytes,
+      bitmap_expr_eval(expr, 7, expr_maps, 4, &map4, NULL)
+   );
+   bench_run("bitmap_expr_eval count only", size, 4 * bytes,
+      bitmap_expr_eval(expr, 7, expr_maps, 4, NULL, &index_result);
+      bench_sink += index_result;
+   );
+
+   bench_run("bitmap_copy", size, 2 * bytes,
+      bitmap_copy(&map2, &map3, 0, 0)
+   );
+   bench_run("bitmap_copy_range (misaligned)", size, 2 * bytes,
+      bitmap_copy_range(&map2, 3, &map3, 5, size - 8)
+   );
+
+   bench_run("bitmap_shift (1 bit)", size, 2 * bytes,
+      bitmap_shift(&map3, 1, r & 0x1 ? 1 : -1, 0, 0)
+   );
+   bench_run("bitmap_shift (1/3 of map)", size, 2 * bytes,
+      bitmap_shift(&map3, size / 3, r & 0x1 ? 1 : -1, 0, 0)
+   );
+   bench_run("bitmap_shift wrap (1 bit)", size, 2 * bytes,
+      bitmap_shift(&map3, 1, r & 0x1 ? 1 : -1, 0, 1)
+   );
+   bench_run("bitmap_shift wrap (1/3 of map)", size, 2 * bytes,
+      bitmap_shift(&map3, size / 3, r & 0x1 ? 1 : -1, 0, 1)
+   );
+
+   // one op is one appended bit, starting from an empty map
+   bench_run_n("bitmap_growable_append", size, size, 0,
+      bitmap_growable_init(&gmap, 0, 0);
+      for (index_result = 0; index_result < size; index_result++) {
+         bitmap_growable_append(&gmap, index_result & 0x1);
+      }
+      bitmap_growable_free(&gmap)
+   );
+
+   free(base1);
+   free(base2);
+   free(base3);
+   free(base4);
+}
+
+static void bench_sfd_arr (unsigned long size) {
+   int* raw;
+
+   unsigned long i;
+
+   sfd_arr_dec_dyn(int, arr, size);
+
+   sfd_arr_dec_sparse(int, sparr, size);
+
+   raw = (int*) malloc(sizeof(int) * size);
+   if (raw == NULL) {
+      printf("bench : malloc failed for %lu ints\n", size);
+      exit(1);
+   }
+
+   bench_fill_index(size);
+
+   bench_run_n("raw array write (seq)", size, size, sizeof(int),
+      for (i = 0; i < size; i++) {
+         raw[i] = i;
+      }
+      bench_sink += raw[r % size];
+   );
+   bench_run_n("sfd_arr_write (seq)", size, size, sizeof(int),
+      for (i = 0; i < size; i++) {
+         sfd_arr_write(arr, i, i);
+      }
+      bench_sink += sfd_arr_read(arr, r % size);
+   );
+
+   bench_run_n("raw array read (seq)", size, size, sizeof(int),
+      for (i = 0; i < size; i++) {
+         bench_sink += raw[i];
+      }
+   );
+   bench_run_n("sfd_arr_read (seq)", size, size, sizeof(int),
+      for (i = 0; i < size; i++) {
+         bench_sink += sfd_arr_read(arr, i);
+      }
+   );
+
+   bench_run("raw array read (random)", size, 0,
+      bench_sink += raw[bench_index[r & (BENCH_INDEX_NUM - 1)]]
+   );
+   bench_run("sfd_arr_read (random)", size, 0,
+      bench_sink += sfd_arr_read(arr, bench_index[r & (BENCH_INDEX_NUM - 1)])
+   );
+
+   bench_run("sfd_arr_write sparse (random)", size, 0,
+      bench_sink += sfd_arr_write(sparr, bench_index[r & (BENCH_INDEX_NUM - 1)], r)
+   );
+   bench_run("sfd_arr_read sparse (random)", size, 0,
+      bench_sink += sfd_arr_read(sparr, bench_index[r & (BENCH_INDEX_NUM - 1)])
+   );
+
+   free(raw);
+   #ifdef SIMPLE_SAFEDATA_DISABLE
+   free(arr);
+   free(sparr);
+   #else
+   free(arr.start);
+   free(arr_sfd_raw_init_map);
+   free(sparr.start);
+   bitmap_sparse_free(&sparr.init_sparse);
+   #endif
+}
+
+static void bench_sfd_var_ptr () {
+   volatile int raw = 0;
+
+   int target = 0;
+
+   sfd_var_dec(int, var);
+
+   sfd_ptr_dec(int*, ptr);
+
+   sfd_var_write(var, 0);
+
+   sfd_ptr_point_nv(ptr, target);
+
+   bench_run("raw variable write", 1, 0,
+      raw = (int) (r & 0xFFFF)
+   );
+   bench_run("sfd_var_write", 1, 0,
+      bench_sink += sfd_var_write(var, (int) (r & 0xFFFF))
+   );
+   bench_run("raw variable read", 1, 0,
+      bench_sink += raw
+   );
+   bench_run("sfd_var_read", 1, 0,
+      bench_sink += sfd_var_read(var)
+   );
+
+   bench_run("sfd_ptr_deref_write", 1, 0,
+      bench_sink += sfd_ptr_deref_write(ptr, (int) (r & 0xFFFF))
+   );
+   bench_run("sfd_ptr_deref_read", 1, 0,
+      bench_sink += sfd_ptr_deref_read(ptr)
+   );
+}
+
+int main (int argc, char* argv[]) {
+   unsigned long max_size = BENCH_MAX_SIZE;
+
+   unsigned long size;
+
+   #ifdef SIMPLE_BITMAP_PARALLEL
+   int threads = BENCH_THREADS;
+
+   if (argc > 2) {
+      threads = atoi(argv[2]);
+   }
+   if (bitmap_parallel_init(threads) != 0) {
+      return 1;
+   }
+   #endif
+
+   if (argc > 1) {
+      max_size = strtoul(argv[1], NULL, 0);
+      if (max_size < BENCH_MIN_SIZE) {
+         printf("bench : max size must be at least %d bits\n", BENCH_MIN_SIZE);
+         return 1;
+      }
+   }
+
+   if (bench_check_search()) {
+      return 1;
+   }
+
+   #ifdef SIMPLE_SAFEDATA_DISABLE
+   printf("sfd disabled, map block is %d bits\n\n", MAP_BLOCK_BIT);
+   #else
+   printf("sfd enabled, map block is %d bits\n\n", MAP_BLOCK_BIT);
+   #endif
+
+   #ifdef SIMPLE_BITMAP_PARALLEL
+   printf("bulk functions use %d threads on maps of at least %lu bits\n\n", threads, (unsigned long) SIMPLE_BITMAP_PARALLEL_THRESHOLD);
+   #endif
+
+   printf("%-32s %12s %14s %10s\n", "operation", "size", "ns/op", "GB/s");
+
+   for (size = BENCH_MIN_SIZE; size <= max_size; size *= BENCH_SIZE_STEP) {
+      bench_bitmap(size);
+      printf("\n");
+   }
+
+   for (size = BENCH_MIN_SIZE; size <= max_size && size <= BENCH_SFD_MAX_SIZE; size *= BENCH_SIZE_STEP) {
+      bench_sfd_arr(size);
+      printf("\n");
+   }
+
+   bench_sfd_var_ptr();
+
+   #ifdef SIMPLE_BITMAP_PARALLEL
+   bitmap_parallel_shutdown();
+   #endif
+
+   return 0;
+}
@@ -102,6 +102,12 @@ int main () {
       // following will terminate the program
       sfd_arr_read(arr0, 10);
       
+      // you can initialise a part of the array (with 0), both ends are inclusive
+      sfd_arr_wipe_range(arr0, 0, 49);
+      
+      // so reading within that part is fine now
+      sfd_arr_read(arr0, 10);
+      
       // you can choose to initialise everything first (with 0)
       sfd_arr_wipe(arr0);
       
@@ -121,6 +127,16 @@ int main () {
       // following will fail since not all are zero
       sfd_arr_write(arr0, 40, 2);
       
+      // constraints can be deferred over a group of writes, and are checked once at the end
+      // writes in between may break them temporarily
+      sfd_arr_batch_begin(arr0);
+      sfd_arr_write(arr0, 41, 5);
+      sfd_arr_write(arr0, 41, 0);
+      // also undo the faulty writes above, in case sfd only reports errors
+      sfd_arr_write(arr0, 1, 0);
+      sfd_arr_write(arr0, 40, 0);
+      sfd_arr_batch_end(arr0);
+      
       
       printf("\n\nsfd demo completed execution successfully!\n");
    return 0;
@@ -8,6 +8,7 @@ MODIFIED:
   980324: renamed seed to flag
   980605: recommend RANDSIZL=4 for noncryptography.
   010626: note this is public domain
+  isaac_fill added for bulk retrieval
 ------------------------------------------------------------------------------
 */
 #ifndef STANDARD
@@ -51,6 +52,14 @@ void isaac(/*_ randctx *r _*/);
      (isaac(r), (r)->randcnt=RANDSIZ-1, (r)->randrsl[(r)->randcnt]) : \
      (r)->randrsl[(r)->randcnt])
 
+/*
+------------------------------------------------------------------------------
+ Call isaac_fill(/o_ randctx *r, ub4 *buf, ub4 n _o/) to retrieve n values
+ at once, in the same order as n calls of rand(r) would
+------------------------------------------------------------------------------
+*/
+void isaac_fill(/*_ randctx *r, ub4 *buf, ub4 n _*/);
+
 #endif  /* RAND */
 
 
@@ -120,6 +120,26 @@ word     flag;
    ctx->randcnt=RANDSIZ;  /* prepare to use the first set of results */
 }
 
+/* fill buf[0..n-1] with the next n results, in the order rand() returns them */
+void isaac_fill(ctx, buf, n)
+randctx *ctx;
+ub4     *buf;
+ub4      n;
+{
+   ub4 *r;
+   r=ctx->randrsl;
+   while (n > 0)
+   {
+      if (!ctx->randcnt)
+      {
+        isaac(ctx);
+        ctx->randcnt=RANDSIZ;
+      }
+      for (; n > 0 && ctx->randcnt > 0; --n)
+        *(buf++) = r[--ctx->randcnt];
+   }
+}
+
 
 #ifdef NEVER
 int main()
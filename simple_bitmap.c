@@ -42,6 +42,192 @@
 #define s_b_min(a, b) ((a) < (b) ? (a) : (b))
 #define s_b_max(a, b) ((a) > (b) ? (a) : (b))
 
+// number of one bits in a map block
+#if defined(__GNUC__) || defined(__clang__)
+   #if SIMPLE_BITMAP_MAP_BLOCK_BIT == 64
+      #define s_b_popcount(block) ((bit_index) __builtin_popcountll(block))
+   #else
+      #define s_b_popcount(block) ((bit_index) __builtin_popcount(block))
+   #endif
+#else
+   #define s_b_popcount(block) s_b_popcount_fallback(block)
+
+static bit_index s_b_popcount_fallback (map_block block) {
+   bit_index count;
+   
+   for (count = 0; block; count++) {
+      block &= block - 1;
+   }
+   
+   return count;
+}
+#endif
+
+// number of leading(most significant) and trailing(least significant) zero bits in a map block
+// block must not be 0
+#if defined(__GNUC__) || defined(__clang__)
+   #if SIMPLE_BITMAP_MAP_BLOCK_BIT == 64
+      #define s_b_clz(block) ((unsigned char) __builtin_clzll(block))
+      #define s_b_ctz(block) ((unsigned char) __builtin_ctzll(block))
+   #else
+      #define s_b_clz(block) ((unsigned char) (__builtin_clzl((unsigned long) (block)) - (sizeof(unsigned long) * CHAR_BIT - MAP_BLOCK_BIT)))
+      #define s_b_ctz(block) ((unsigned char) __builtin_ctzl((unsigned long) (block)))
+   #endif
+#else
+   #define s_b_clz(block) s_b_clz_fallback(block)
+   #define s_b_ctz(block) s_b_ctz_fallback(block)
+
+static unsigned char s_b_clz_fallback (map_block block) {
+   unsigned char count;
+   
+   for (count = 0; !(block & ((map_block) 0x1 << (MAP_BLOCK_BIT - 1))); count++) {
+      block <<= 1;
+   }
+   
+   return count;
+}
+
+static unsigned char s_b_ctz_fallback (map_block block) {
+   unsigned char count;
+   
+   for (count = 0; !(block & 0x1); count++) {
+      block >>= 1;
+   }
+   
+   return count;
+}
+#endif
+
+// number of one bits, trailing and leading zero bits in a 64 bit word
+// word must not be 0 for the latter two
+#if defined(__GNUC__) || defined(__clang__)
+   #define s_b_popcount64(word) ((uint_fast32_t) __builtin_popcountll(word))
+   #define s_b_ctz64(word)      ((uint_fast32_t) __builtin_ctzll(word))
+   #define s_b_clz64(word)      ((uint_fast32_t) __builtin_clzll(word))
+#else
+   #define s_b_popcount64(word) s_b_popcount64_fallback(word)
+   #define s_b_ctz64(word)      s_b_ctz64_fallback(word)
+   #define s_b_clz64(word)      s_b_clz64_fallback(word)
+
+static uint_fast32_t s_b_popcount64_fallback (uint64_t word) {
+   uint_fast32_t count;
+   
+   for (count = 0; word; count++) {
+      word &= word - 1;
+   }
+   
+   return count;
+}
+
+static uint_fast32_t s_b_ctz64_fallback (uint64_t word) {
+   uint_fast32_t count;
+   
+   for (count = 0; !(word & 0x1); count++) {
+      word >>= 1;
+   }
+   
+   return count;
+}
+
+static uint_fast32_t s_b_clz64_fallback (uint64_t word) {
+   uint_fast32_t count;
+   
+   for (count = 0; !(word >> 63); count++) {
+      word <<= 1;
+   }
+   
+   return count;
+}
+#endif
+
+// position, counted from the most significant bit, of the k-th(counted from 0) one bit of a 64 bit word
+// counted from the most significant bit, word must have more than k one bits
+#if defined(__BMI2__) && (defined(__GNUC__) || defined(__clang__))
+   #include <immintrin.h>
+   
+   #define s_b_select64(word, k) ((uint_fast32_t) (63 - __builtin_ctzll(\
+               _pdep_u64((uint64_t) 0x1 << (s_b_popcount64(word) - 1 - (k)), word))))
+#else
+   #define s_b_select64(word, k) s_b_select64_fallback(word, k)
+
+static uint_fast32_t s_b_select64_fallback (uint64_t word, uint_fast32_t k) {
+   uint_fast32_t pos;
+   uint_fast32_t ones;
+   
+   // whole bytes first
+   for (pos = 0; (ones = s_b_popcount64(word >> 56)) <= k; pos += 8) {
+      k -= ones;
+      word <<= 8;
+   }
+   
+   for (;; pos++, word <<= 1) {
+      if (word >> 63) {
+         if (k == 0) {
+            return pos;
+         }
+         k--;
+      }
+   }
+}
+#endif
+
+#ifdef SIMPLE_BITMAP_ATOMIC
+// atomic operations on map blocks and counters
+#if defined(__GNUC__) || defined(__clang__)
+   #define s_b_atomic_fetch_or(ptr, val)    __atomic_fetch_or(ptr, val, __ATOMIC_ACQ_REL)
+   #define s_b_atomic_fetch_and(ptr, val)   __atomic_fetch_and(ptr, val, __ATOMIC_ACQ_REL)
+   #define s_b_atomic_load(ptr)             __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+   #define s_b_atomic_count_add(ptr, val)   __atomic_add_fetch(ptr, val, __ATOMIC_RELAXED)
+   #define s_b_atomic_count_load(ptr)       __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#else
+   #include <stdatomic.h>
+   #define s_b_atomic_fetch_or(ptr, val)    atomic_fetch_or_explicit((_Atomic map_block*) (ptr), val, memory_order_acq_rel)
+   #define s_b_atomic_fetch_and(ptr, val)   atomic_fetch_and_explicit((_Atomic map_block*) (ptr), val, memory_order_acq_rel)
+   #define s_b_atomic_load(ptr)             atomic_load_explicit((_Atomic map_block*) (ptr), memory_order_acquire)
+   #define s_b_atomic_count_add(ptr, val)   (atomic_fetch_add_explicit((_Atomic long*) (ptr), val, memory_order_relaxed) + (val))
+   #define s_b_atomic_count_load(ptr)       atomic_load_explicit((_Atomic long*) (ptr), memory_order_relaxed)
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+   #define s_b_thread_local __thread
+#else
+   #define s_b_thread_local _Thread_local
+#endif
+
+// mask with the n most significant bits set, 1 <= n <= MAP_BLOCK_BIT
+#define s_b_head_mask(n) ((map_block) ~((map_block) -1 >> 1 >> ((n) - 1)))
+// mask with the n least significant bits set, 1 <= n <= MAP_BLOCK_BIT
+#define s_b_tail_mask(n) ((map_block) ((map_block) -1 >> (MAP_BLOCK_BIT - (n))))
+
+#define s_b_bit_assign(base, index, val) do {\
+               if (val) {\
+                  (base)[get_bitmap_map_block_index(index)] |=\
+                     (map_block) 0x1 << (MAP_BLOCK_BIT - 1 - get_bitmap_map_block_bit_index(index));\
+               }\
+               else {\
+                  (base)[get_bitmap_map_block_index(index)] &=\
+                     (map_block) ~((map_block) 0x1 << (MAP_BLOCK_BIT - 1 - get_bitmap_map_block_bit_index(index)));\
+               }\
+            } while (0)
+
+// level 1 and level 2 of the summary index for one bits(bit_type 1) or zero bits(bit_type 0)
+#define s_b_summary_level1(map, bit_type) ((map)->summary + ((bit_type) ? 0 :\
+               get_bitmap_summary_level1_number((map)->summary_capacity) + get_bitmap_summary_level2_number((map)->summary_capacity)))
+#define s_b_summary_level2(map, bit_type) (s_b_summary_level1(map, bit_type) + get_bitmap_summary_level1_number((map)->summary_capacity))
+
+// number of map blocks covered by one entry of the rank index
+#define S_B_RANK_SUPERBLOCK_BLOCKS (BITMAP_RANK_SUPERBLOCK_BIT / MAP_BLOCK_BIT)
+
+// marks the entries of the rank index after the superblock holding map block block as stale,
+// does nothing to a map without rank index as rank_valid is 0
+#define s_b_rank_touch(map, block) do {\
+               if ((map)->rank_valid > (bit_index) (block) / S_B_RANK_SUPERBLOCK_BLOCKS + 1) {\
+                  (map)->rank_valid = (bit_index) (block) / S_B_RANK_SUPERBLOCK_BLOCKS + 1;\
+               }\
+            } while (0)
+#define s_b_rank_touch_all(map) s_b_rank_touch(map, 0)
+
 #define s_b_encrypt(start, size, counter, key) do {\
                for (counter = 0; counter < size; counter++) {\
                   *((unsigned char*) start + counter) ^= (unsigned char) (key >> ((counter % 4) * CHAR_BIT));\
@@ -49,10 +235,10 @@
             } while (0)
 #define s_b_decrypt(start, size, counter, key) s_b_encrypt(start, size, counter, key)
 
-#define s_b_rand_fill(start, size, counter, rand_ctx, temp) do {\
-               for (counter = 0; counter < size; counter++) {\
-                  if (counter % 4 == 0) {temp = rand(&rand_ctx);}\
-                  *((unsigned char*) start + counter) = (unsigned char) (temp >> ((counter % 4) * CHAR_BIT));\
+// takes the random bytes from pool, an array of 32-bit isaac results, starting at byte pos
+#define s_b_rand_fill(start, size, counter, pool, pos) do {\
+               for (counter = 0; counter < size; counter++, pos++) {\
+                  *((unsigned char*) start + counter) = (unsigned char) ((pool)[pos / 4] >> ((pos % 4) * CHAR_BIT));\
                }\
             } while (0)
 
@@ -62,18 +248,89 @@
                }\
             } while (0)
 
-int bitmap_init (simple_bitmap* map, map_block* base, map_block* end, uint_fast32_t size_in_bits, map_block default_value) {
-   //int ret_temp;
+#ifdef SIMPLE_BITMAP_META_DATA_SECURITY
+// size of the five secure fields
+#define S_B_SECURE_FIELDS_SIZE (sizeof(((simple_bitmap*) 0)->base) + sizeof(((simple_bitmap*) 0)->end)\
+               + sizeof(((simple_bitmap*) 0)->length)\
+               + sizeof(((simple_bitmap*) 0)->number_of_zeros) + sizeof(((simple_bitmap*) 0)->number_of_ones))
+
+// number of random words one encryption uses at most,
+// the zero runs, the dummy slots and the unused slots of the secure fields plus the unused degrees
+#define S_B_RAND_POOL_WORDS ((3 * S_B_SECURE_FIELDS_SIZE + sizeof(((simple_bitmap*) 0)->rand_degrees) + 3) / 4)
+
+// global keys, see the scheme in simple_bitmap.h
+uint_fast32_t  rand_encrypt_xor_meta;
+uint_fast32_t  rand_encrypt_add_meta;
+uint_fast32_t  rand_encrypt_xor_meta2;
+uint_fast32_t  rand_encrypt_add_meta2;
+uint_fast32_t  rand_cookie_correct_meta;
+randctx s_b_rand_ctx;
+
+static pthread_once_t s_b_rand_once = PTHREAD_ONCE_INIT;
+
+// guards s_b_rand_ctx, which is only drawn from to seed the contexts of the threads
+static pthread_mutex_t s_b_rand_seed_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static s_b_thread_local randctx s_b_rand_thread_ctx;
+static s_b_thread_local unsigned char s_b_rand_thread_ctx_init;
+
+// INTERNAL USE, run once through s_b_rand_once
+// seeds the global context and picks the global keys
+static void map_blocks_rand_global_init () {
+   unsigned char count;
    
-   #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
-   uint_least8_t offsets;
+   time_t timer;
    
-   unsigned char count = 0;
+   time(&timer);
    
-   uint_fast32_t temp;
+   for (count = 0; count < sizeof(timer); count++) {
+      s_b_rand_ctx.randrsl[count] = (timer >> (count*8))&((unsigned char) -1);
+   }
    
-   time_t timer;
+   randinit(&s_b_rand_ctx, TRUE);
    
+   rand_encrypt_xor_meta = rand(&s_b_rand_ctx);
+   rand_encrypt_add_meta = rand(&s_b_rand_ctx);
+   rand_encrypt_xor_meta2 = rand(&s_b_rand_ctx);
+   rand_encrypt_add_meta2 = rand(&s_b_rand_ctx);
+   rand_cookie_correct_meta = rand(&s_b_rand_ctx);
+}
+
+// INTERNAL USE
+// returns the random context of the calling thread, seeded from the global one on first use
+static randctx* map_blocks_rand_ctx () {
+   if (!s_b_rand_thread_ctx_init) {
+      pthread_once(&s_b_rand_once, map_blocks_rand_global_init);
+      
+      pthread_mutex_lock(&s_b_rand_seed_lock);
+      isaac_fill(&s_b_rand_ctx, s_b_rand_thread_ctx.randrsl, (ub4) RANDSIZ);
+      pthread_mutex_unlock(&s_b_rand_seed_lock);
+      
+      randinit(&s_b_rand_thread_ctx, TRUE);
+      
+      s_b_rand_thread_ctx_init = 1;
+   }
+   
+   return &s_b_rand_thread_ctx;
+}
+
+// INTERNAL USE, map must be decrypted
+// picks new keys and a new layout for the secure fields
+static void map_blocks_meta_rekey (simple_bitmap* map) {
+   randctx* ctx = map_blocks_rand_ctx();
+   
+   map->obj_rand_encrypt_xor_meta = rand(ctx);
+   map->obj_rand_encrypt_add_meta = rand(ctx);
+   map->obj_rand_encrypt_xor_meta2 = rand(ctx);
+   map->obj_rand_encrypt_add_meta2 = rand(ctx);
+   map->offsets                   = rand(ctx);
+}
+#endif
+
+// INTERNAL USE
+// sets up the meta data of map, without touching the map blocks or the counts
+static int map_blocks_meta_init (simple_bitmap* map, map_block* base, map_block* end, uint_fast32_t size_in_bits) {
+   #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
    if (map == NULL) {
@@ -82,37 +339,11 @@ int bitmap_init (simple_bitmap* map, map_block* base, map_block* end, uint_fast3
    }
    #endif
    
-   // setup global random things
-   if (!rand_things_init) {
-      pthread_mutex_lock(&rand_things_init_lock);
-      if (!rand_things_init) {
-         // initialise randomness
-         time(&timer);
-         
-         for (count = 0; count < sizeof(timer); count++) {
-            s_b_rand_ctx.randrsl[count] = (timer >> (count*8))&((unsigned char) -1);
-         }
-         
-         randinit(&s_b_rand_ctx);
-         
-         rand_encrypt_xor_meta = rand(&s_b_rand_ctx);
-         rand_encrypt_add_meta = rand(&s_b_rand_ctx);
-         rand_encrypt_xor_meta2 = rand(&s_b_rand_ctx);
-         rand_encrypt_add_meta2 = rand(&s_b_rand_ctx);
-         rand_cookie_correct_meta = rand(&s_b_rand_ctx);
-      }
-      rand_things_init = 1;
-      pthread_mutex_unlock(&rand_things_init_lock);
-   }
-   
-   map->obj_rand_encrypt_xor_meta = rand(&s_b_rand_ctx);
-   map->obj_rand_encrypt_add_meta = rand(&s_b_rand_ctx);
-   map->obj_rand_encrypt_xor_meta2 = rand(&s_b_rand_ctx);
-   map->obj_rand_encrypt_add_meta2 = rand(&s_b_rand_ctx);
-   map->offsets                   = rand(&s_b_rand_ctx);
-   map->obj_cookie_meta           = rand(&s_b_rand_ctx);
+   // also sets up the global keys on first use
+   map_blocks_meta_rekey(map);
+   map->obj_cookie_meta           = rand(map_blocks_rand_ctx());
    
-   offsets = map->offsets;
+   map->unlock_depth = 0;
    #endif
    
    // input check
@@ -135,8 +366,25 @@ int bitmap_init (simple_bitmap* map, map_block* base, map_block* end, uint_fast3
    
    map->base = base;
    
+   map->summary = NULL;
+   map->summary_capacity = 0;
+   
+   map->rank = NULL;
+   map->rank_capacity = 0;
+   map->rank_valid = 0;
+   
    bitmap_meta_encrypt(map);
    
+   return 0;
+}
+
+int bitmap_init (simple_bitmap* map, map_block* base, map_block* end, uint_fast32_t size_in_bits, map_block default_value) {
+   int ret;
+   
+   if ((ret = map_blocks_meta_init(map, base, end, size_in_bits))) {
+      return ret;
+   }
+   
    if (default_value > 1) {
       // ;  // do nothing
       return bitmap_count_zeros_and_ones(map);
@@ -163,7 +411,8 @@ int bitmap_meta_encrypt (simple_bitmap* map) {
    
    uint_least8_t rand_indicators;
    
-   uint_fast32_t temp;
+   ub4 rand_pool[S_B_RAND_POOL_WORDS];
+   unsigned int rand_pos;
    
    unsigned char* cur1,* cur2;
    
@@ -177,6 +426,17 @@ int bitmap_meta_encrypt (simple_bitmap* map) {
    }
    #endif
    
+   // still decrypted for an enclosing call or session
+   if (map->unlock_depth > 1) {
+      map->unlock_depth--;
+      return 0;
+   }
+   map->unlock_depth = 0;
+   
+   // draw all random bytes this encryption may need at once
+   isaac_fill(map_blocks_rand_ctx(), rand_pool, (ub4) S_B_RAND_POOL_WORDS);
+   rand_pos = 0;
+   
    key = (map->obj_rand_encrypt_xor_meta + rand_encrypt_add_meta)
          ^ rand_encrypt_xor_meta + (map->obj_rand_encrypt_add_meta ^ rand_encrypt_xor_meta);
          
@@ -197,6 +457,8 @@ int bitmap_meta_encrypt (simple_bitmap* map) {
    map->number_of_ones_a[((offsets >> OFF_NO)&0x1)]   = map->number_of_ones;
    
    // remove pattern that can cause major weakness
+   // only the first run of zero bytes of each field is randomised,
+   // as decryption sets the whole range back to zero bytes
    rand_indicators = 0;
    // handle base and end addresses
    rand_degrees[OFF_BA][0] = 0xFF;
@@ -209,14 +471,20 @@ int bitmap_meta_encrypt (simple_bitmap* map) {
       if (*cur1 == 0x00) {
          if (rand_degrees[OFF_BA][0] == 0xFF) {
             rand_degrees[OFF_BA][0] = count;
+            rand_degrees[OFF_BA][1] = count;
+         }
+         else if (rand_degrees[OFF_BA][1] == count - 1) {
+            rand_degrees[OFF_BA][1] = count;
          }
-         rand_degrees[OFF_BA][1] = count;
       }
       if (*cur2 == 0x00) {
          if (rand_degrees[OFF_EN][0] == 0xFF) {
             rand_degrees[OFF_EN][0] = count;
+            rand_degrees[OFF_EN][1] = count;
+         }
+         else if (rand_degrees[OFF_EN][1] == count - 1) {
+            rand_degrees[OFF_EN][1] = count;
          }
-         rand_degrees[OFF_EN][1] = count;
       }
    }
    if (rand_degrees[OFF_BA][1] - rand_degrees[OFF_BA][0] + 1 > 0) {
@@ -233,8 +501,11 @@ int bitmap_meta_encrypt (simple_bitmap* map) {
       if (*cur1 == 0x00) {
          if (rand_degrees[OFF_LE][0] == 0xFF) {
             rand_degrees[OFF_LE][0] = count;
+            rand_degrees[OFF_LE][1] = count;
+         }
+         else if (rand_degrees[OFF_LE][1] == count - 1) {
+            rand_degrees[OFF_LE][1] = count;
          }
-         rand_degrees[OFF_LE][1] = count;
       }
    }
    if (rand_degrees[OFF_LE][1] - rand_degrees[OFF_LE][0] + 1 > 0) {
@@ -250,14 +521,20 @@ int bitmap_meta_encrypt (simple_bitmap* map) {
       if (*cur1 == 0x00) {
          if (rand_degrees[OFF_NZ][0] == 0xFF) {
             rand_degrees[OFF_NZ][0] = count;
+            rand_degrees[OFF_NZ][1] = count;
+         }
+         else if (rand_degrees[OFF_NZ][1] == count - 1) {
+            rand_degrees[OFF_NZ][1] = count;
          }
-         rand_degrees[OFF_NZ][1] = count;
       }
       if (*cur2 == 0x00) {
          if (rand_degrees[OFF_NO][0] == 0xFF) {
             rand_degrees[OFF_NO][0] = count;
+            rand_degrees[OFF_NO][1] = count;
+         }
+         else if (rand_degrees[OFF_NO][1] == count - 1) {
+            rand_degrees[OFF_NO][1] = count;
          }
-         rand_degrees[OFF_NO][1] = count;
       }
    }
    if (rand_degrees[OFF_NZ][1] - rand_degrees[OFF_NZ][0] + 1 > 0) {
@@ -268,13 +545,15 @@ int bitmap_meta_encrypt (simple_bitmap* map) {
    }
    
    s_b_rand_fill((unsigned char*) (&map->base_a[((offsets >> OFF_BA)&0x1)]) + rand_degrees[OFF_BA][0],
-                  rand_degrees[OFF_BA][1] - rand_degrees[OFF_BA][0] + 1, count, s_b_rand_ctx, temp);
+                  rand_degrees[OFF_BA][1] - rand_degrees[OFF_BA][0] + 1, count, rand_pool, rand_pos);
    s_b_rand_fill((unsigned char*) (&map->end_a[((offsets >> OFF_EN)&0x1)]) + rand_degrees[OFF_EN][0],
-                  rand_degrees[OFF_EN][1] - rand_degrees[OFF_EN][0] + 1, count, s_b_rand_ctx, temp);
+                  rand_degrees[OFF_EN][1] - rand_degrees[OFF_EN][0] + 1, count, rand_pool, rand_pos);
+   s_b_rand_fill((unsigned char*) (&map->length_a[((offsets >> OFF_LE)&0x1)]) + rand_degrees[OFF_LE][0],
+                  rand_degrees[OFF_LE][1] - rand_degrees[OFF_LE][0] + 1, count, rand_pool, rand_pos);
    s_b_rand_fill((unsigned char*) (&map->number_of_zeros_a[((offsets >> OFF_NZ)&0x1)]) + rand_degrees[OFF_NZ][0],
-                  rand_degrees[OFF_NZ][1] - rand_degrees[OFF_NZ][0] + 1, count, s_b_rand_ctx, temp);
+                  rand_degrees[OFF_NZ][1] - rand_degrees[OFF_NZ][0] + 1, count, rand_pool, rand_pos);
    s_b_rand_fill((unsigned char*) (&map->number_of_ones_a[((offsets >> OFF_NO)&0x1)]) + rand_degrees[OFF_NO][0],
-                  rand_degrees[OFF_NO][1] - rand_degrees[OFF_NO][0] + 1, count, s_b_rand_ctx, temp);
+                  rand_degrees[OFF_NO][1] - rand_degrees[OFF_NO][0] + 1, count, rand_pool, rand_pos);
    
    map->rand_indicators = rand_indicators;
    for (count = 0; count < 5; count++) {
@@ -283,8 +562,8 @@ int bitmap_meta_encrypt (simple_bitmap* map) {
          map->rand_degrees[count][1] = rand_degrees[count][1];
       }
       else {
-         s_b_rand_fill(&map->rand_degrees[count][0], sizeof(map->rand_degrees[0][0]), count2, s_b_rand_ctx, temp);
-         s_b_rand_fill(&map->rand_degrees[count][1], sizeof(map->rand_degrees[0][0]), count2, s_b_rand_ctx, temp);
+         s_b_rand_fill(&map->rand_degrees[count][0], sizeof(map->rand_degrees[0][0]), count2, rand_pool, rand_pos);
+         s_b_rand_fill(&map->rand_degrees[count][1], sizeof(map->rand_degrees[0][0]), count2, rand_pool, rand_pos);
       }
       rand_degrees[count][0] = 0;
       rand_degrees[count][1] = 0;
@@ -301,23 +580,24 @@ int bitmap_meta_encrypt (simple_bitmap* map) {
    s_b_encrypt(&map->rand_degrees, sizeof(map->rand_degrees), count, key2);
    
    // fill dummy slots
-   s_b_rand_fill(&map->base_a[!((offsets >> OFF_BA)&0x1)], sizeof(map->base_a[0]), count, s_b_rand_ctx, temp);
-   s_b_rand_fill(&map->end_a[!((offsets >> OFF_EN)&0x1)], sizeof(map->end_a[0]), count, s_b_rand_ctx, temp);
-   s_b_rand_fill(&map->length_a[!((offsets >> OFF_LE)&0x1)], sizeof(map->length_a[0]), count, s_b_rand_ctx, temp);
-   s_b_rand_fill(&map->number_of_zeros_a[!((offsets >> OFF_NZ)&0x1)], sizeof(map->number_of_zeros_a[0]), count, s_b_rand_ctx, temp);
-   s_b_rand_fill(&map->number_of_ones_a[!((offsets >> OFF_NO)&0x1)], sizeof(map->number_of_ones_a[0]), count, s_b_rand_ctx, temp);
+   s_b_rand_fill(&map->base_a[!((offsets >> OFF_BA)&0x1)], sizeof(map->base_a[0]), count, rand_pool, rand_pos);
+   s_b_rand_fill(&map->end_a[!((offsets >> OFF_EN)&0x1)], sizeof(map->end_a[0]), count, rand_pool, rand_pos);
+   s_b_rand_fill(&map->length_a[!((offsets >> OFF_LE)&0x1)], sizeof(map->length_a[0]), count, rand_pool, rand_pos);
+   s_b_rand_fill(&map->number_of_zeros_a[!((offsets >> OFF_NZ)&0x1)], sizeof(map->number_of_zeros_a[0]), count, rand_pool, rand_pos);
+   s_b_rand_fill(&map->number_of_ones_a[!((offsets >> OFF_NO)&0x1)], sizeof(map->number_of_ones_a[0]), count, rand_pool, rand_pos);
    
    // fill unused data slots
-   s_b_rand_fill(&map->base, sizeof(map->base), count, s_b_rand_ctx, temp);
-   s_b_rand_fill(&map->end, sizeof(map->end), count, s_b_rand_ctx, temp);
-   s_b_rand_fill(&map->length, sizeof(map->length), count, s_b_rand_ctx, temp);
-   s_b_rand_fill(&map->number_of_zeros, sizeof(map->number_of_zeros), count, s_b_rand_ctx, temp);
-   s_b_rand_fill(&map->number_of_ones, sizeof(map->number_of_ones), count, s_b_rand_ctx, temp);
+   s_b_rand_fill(&map->base, sizeof(map->base), count, rand_pool, rand_pos);
+   s_b_rand_fill(&map->end, sizeof(map->end), count, rand_pool, rand_pos);
+   s_b_rand_fill(&map->length, sizeof(map->length), count, rand_pool, rand_pos);
+   s_b_rand_fill(&map->number_of_zeros, sizeof(map->number_of_zeros), count, rand_pool, rand_pos);
+   s_b_rand_fill(&map->number_of_ones, sizeof(map->number_of_ones), count, rand_pool, rand_pos);
    
    // clear stack
    key = 0;
    key2 = 0;
    offsets = 0;
+   memset(rand_pool, 0, sizeof(rand_pool));
    
    return 0;
 }
@@ -342,6 +622,11 @@ int bitmap_meta_decrypt (simple_bitmap* map) {
    }
    #endif
    
+   // already decrypted by an enclosing call or session
+   if (map->unlock_depth++) {
+      return 0;
+   }
+   
    key = (map->obj_rand_encrypt_xor_meta + rand_encrypt_add_meta)
          ^ rand_encrypt_xor_meta + (map->obj_rand_encrypt_add_meta ^ rand_encrypt_xor_meta);
          
@@ -406,805 +691,1272 @@ int bitmap_meta_decrypt (simple_bitmap* map) {
    
    return 0;
 }
-#endif
 
-int bitmap_zero (simple_bitmap* map) {
-   map_block* cur;
-   
-   bitmap_meta_decrypt(map);
+int bitmap_meta_unlock (simple_bitmap* map) {
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_meta_unlock : map is NULL\n");
+      return WRONG_INPUT;
+   }
+   #endif
    
+   return bitmap_meta_decrypt(map);
+}
+
+int bitmap_meta_relock (simple_bitmap* map) {
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
    if (map == NULL) {
-      printf("bitmap_zero : map is NULL\n");
+      printf("bitmap_meta_relock : map is NULL\n");
       return WRONG_INPUT;
    }
-   if (map->base == NULL) {
-      printf("bitmap_zero : base is NULL\n");
-      return CORRUPTED_DATA;
+   if (map->unlock_depth == 0) {
+      printf("bitmap_meta_relock : map is not unlocked\n");
+      return WRONG_INPUT;
    }
-   if (map->end == NULL) {
-      printf("bitmap_zero : end is NULL\n");
-      return CORRUPTED_DATA;
+   #endif
+   
+   // end of the outermost session, do not reuse the keys or the layout the plain meta data was exposed under
+   if (map->unlock_depth == 1) {
+      map_blocks_meta_rekey(map);
    }
-   if (map->length == 0) {
-      printf("bitmap_zero : map has no length\n");
-      return CORRUPTED_DATA;
+   
+   return bitmap_meta_encrypt(map);
+}
+#endif
+
+// INTERNAL USE
+// returns ret from a failed call, re-encrypting the maps it decrypted before failing(NULL maps are skipped),
+// so the unlock depth of each map is back to what it was and its meta data is sealed again
+static int map_blocks_check_fail (int ret, simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* map3) {
+   #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
+   if (map1 != NULL) {
+      bitmap_meta_encrypt(map1);
+   }
+   if (map2 != NULL) {
+      bitmap_meta_encrypt(map2);
    }
+   if (map3 != NULL) {
+      bitmap_meta_encrypt(map3);
+   }
+   #else
+   (void) map1;
+   (void) map2;
+   (void) map3;
    #endif
    
-   // write 0s
-   for (cur = map->base; cur <= map->end; cur++) {
-      *cur = 0;
+   return ret;
+}
+
+// INTERNAL USE
+// returns index of the first one bit at or after from in blocks[0 .. num-1],
+// or num * MAP_BLOCK_BIT if there is none
+static bit_index map_blocks_scan_fwd (map_block* blocks, bit_index num, bit_index from) {
+   bit_index index;
+   
+   map_block buf;
+   
+   if (from >= num * MAP_BLOCK_BIT) {
+      return num * MAP_BLOCK_BIT;
    }
    
-   map->number_of_zeros = map->length;
-   map->number_of_ones = 0;
+   index = get_bitmap_map_block_index(from);
    
-   bitmap_meta_encrypt(map);
+   buf = blocks[index] & s_b_tail_mask(MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(from));
    
-   return 0;
+   while (buf == 0) {
+      index++;
+      if (index >= num) {
+         return num * MAP_BLOCK_BIT;
+      }
+      buf = blocks[index];
+   }
+   
+   return index * MAP_BLOCK_BIT + s_b_clz(buf);
 }
 
-int bitmap_one (simple_bitmap* map) {
-   map_block mask;
+// INTERNAL USE
+// returns index of the last one bit at or before from in blocks[0 .. num-1],
+// or num * MAP_BLOCK_BIT if there is none
+static bit_index map_blocks_scan_back (map_block* blocks, bit_index num, bit_index from) {
+   bit_index index;
    
-   //map_block buf;
-   
-   map_block* cur;
+   map_block buf;
    
-   unsigned char count;
+   index = get_bitmap_map_block_index(from);
    
-   bitmap_meta_decrypt(map);
+   buf = blocks[index] & s_b_head_mask(get_bitmap_map_block_bit_index(from) + 1);
    
-   // input check
-   #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_one : map is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map->base == NULL) {
-      printf("bitmap_one : base is NULL\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->end == NULL) {
-      printf("bitmap_one : end is NULL\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->length == 0) {
-      printf("bitmap_one : map has no length\n");
-      return CORRUPTED_DATA;
+   while (buf == 0) {
+      if (index == 0) {
+         return num * MAP_BLOCK_BIT;
+      }
+      index--;
+      buf = blocks[index];
    }
-   #endif
    
-   // write 1s
-   for (cur = map->base; cur <= map->end; cur++) {
-      *cur = (map_block) -1;
-   }
+   return index * MAP_BLOCK_BIT + (MAP_BLOCK_BIT - 1 - s_b_ctz(buf));
+}
+
+// INTERNAL USE, map must be decrypted and have a summary attached
+// refreshes the summary bits of a single map block
+static int map_blocks_summary_update (simple_bitmap* map, bit_index block) {
+   map_block* level1;
+   map_block* level2;
    
-   cur = map->end;
+   map_block buf_one;
+   map_block buf_zero;
    
-   // set the extra bits back to 0
-   mask = 0;
-   for (count = 0; count <= get_bitmap_map_block_bit_index(map->length-1); count++) {
-      mask |= 0x1 << (MAP_BLOCK_BIT - count - 1);
+   buf_one = map->base[block];
+   buf_zero = buf_one;
+   
+   // padding bits of the last map block do not count as zeros
+   if (map->base + block == map->end) {
+      buf_zero |= (map_block) ~s_b_head_mask(get_bitmap_map_block_bit_index(map->length-1) + 1);
    }
-   *cur &= mask;
    
-   map->number_of_zeros = 0;
-   map->number_of_ones = map->length;
+   level1 = s_b_summary_level1(map, 0x1);
+   level2 = s_b_summary_level2(map, 0x1);
+   s_b_bit_assign(level1, block, buf_one != 0);
+   s_b_bit_assign(level2, get_bitmap_map_block_index(block), level1[get_bitmap_map_block_index(block)] != 0);
    
-   bitmap_meta_encrypt(map);
+   level1 = s_b_summary_level1(map, 0x0);
+   level2 = s_b_summary_level2(map, 0x0);
+   s_b_bit_assign(level1, block, buf_zero != (map_block) -1);
+   s_b_bit_assign(level2, get_bitmap_map_block_index(block), level1[get_bitmap_map_block_index(block)] != 0);
    
    return 0;
 }
 
-static int map_blocks_ferris_wheel_flip (map_block* start, map_block* end, uint_fast32_t count) {
-   map_block* start1 = start;
-   map_block* start2 = end - count + 1;
-   map_block temp;
+// INTERNAL USE, map must be decrypted and have a summary attached
+static int map_blocks_summary_rebuild (simple_bitmap* map) {
+   bit_index block;
+   bit_index num;
+   bit_index size;
+   
+   num = map->end - map->base + 1;
+   size = get_bitmap_summary_map_block_number(map->summary_capacity);
+   
+   // summary bits of map blocks beyond the end must stay 0
+   for (block = 0; block < size; block++) {
+      map->summary[block] = 0;
+   }
    
-   for (; start2 <= end; start1++, start2++) {
-      temp = *start2;
-      *start2 = *start1;
-      *start1 = temp;
+   for (block = 0; block < num; block++) {
+      map_blocks_summary_update(map, block);
    }
    
    return 0;
 }
 
-int bitmap_shift (simple_bitmap* map, bit_index offset, char direction, map_block default_val, unsigned char wrap_around) {
-   map_block* start;
-   map_block* end;
+// INTERNAL USE, map must be decrypted and have a summary attached
+// returns index of the first map block at or after from which has a bit of bit_type,
+// or the number of map blocks if there is none
+static bit_index map_blocks_summary_next (simple_bitmap* map, bit_index from, map_block bit_type) {
+   map_block* level1 = s_b_summary_level1(map, bit_type);
+   map_block* level2 = s_b_summary_level2(map, bit_type);
    
-   //map_block* end2;
+   bit_index num = map->end - map->base + 1;
+   bit_index num1 = get_bitmap_map_block_number(num);
+   bit_index num2 = get_bitmap_map_block_number(num1);
    
-   //map_block mask_clear;
+   bit_index index;
    
-   map_block temp;
+   map_block buf;
    
-   uint_fast16_t blocks_to_shift;
+   if (from >= num) {
+      return num;
+   }
    
-   unsigned char bits_to_shift;
+   index = get_bitmap_map_block_index(from);
    
-   //unsigned char count;
+   buf = level1[index] & s_b_tail_mask(MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(from));
+   if (buf != 0) {
+      return index * MAP_BLOCK_BIT + s_b_clz(buf);
+   }
    
-   char shrink_direction;
+   // use level 2 to find the next level 1 map block with any bit set
+   index = map_blocks_scan_fwd(level2, num2, index + 1);
+   if (index >= num1) {
+      return num;
+   }
    
-   uint_fast32_t move_count;
+   return index * MAP_BLOCK_BIT + s_b_clz(level1[index]);
+}
+
+// INTERNAL USE, map must be decrypted and have a summary attached
+// returns index of the last map block at or before from which has a bit of bit_type,
+// or the number of map blocks if there is none
+static bit_index map_blocks_summary_prev (simple_bitmap* map, bit_index from, map_block bit_type) {
+   map_block* level1 = s_b_summary_level1(map, bit_type);
+   map_block* level2 = s_b_summary_level2(map, bit_type);
    
-   map_block* start1;
+   bit_index num = map->end - map->base + 1;
+   bit_index num1 = get_bitmap_map_block_number(num);
+   bit_index num2 = get_bitmap_map_block_number(num1);
    
-   map_block* cur;
+   bit_index index;
    
-   //map_block* temp_end;
+   map_block buf;
    
-   bitmap_meta_decrypt(map);
+   index = get_bitmap_map_block_index(from);
    
-   // input check
-   #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_shift : map is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map->base == NULL) {
-      printf("bitmap_shift : base is NULL\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->end == NULL) {
-      printf("bitmap_shift : end is NULL\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->length == 0) {
-      printf("bitmap_shift : map has no length\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_shift : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_shift : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   buf = level1[index] & s_b_head_mask(get_bitmap_map_block_bit_index(from) + 1);
+   if (buf != 0) {
+      return index * MAP_BLOCK_BIT + (MAP_BLOCK_BIT - 1 - s_b_ctz(buf));
    }
-   #endif
    
-   blocks_to_shift = offset / MAP_BLOCK_BIT;
-   
-   bits_to_shift = offset % MAP_BLOCK_BIT;
+   if (index == 0) {
+      return num;
+   }
    
-   if (blocks_to_shift == 0) {
-      goto bitshift;
+   // use level 2 to find the previous level 1 map block with any bit set
+   index = map_blocks_scan_back(level2, num2, index - 1);
+   if (index >= num1) {
+      return num;
    }
    
-   if (!wrap_around) {  // no need to rotate
-      if (blocks_to_shift >= get_bitmap_map_block_number(map->length)) {
-         if (default_val > 1) {
-            ; // do nothing
+   return index * MAP_BLOCK_BIT + (MAP_BLOCK_BIT - 1 - s_b_ctz(level1[index]));
+}
+
+#define S_B_OP_AND   0
+#define S_B_OP_OR    1
+#define S_B_OP_XOR   2
+#define S_B_OP_NOT   3
+#define S_B_OP_COUNT 4
+#define S_B_OP_ZERO  5
+#define S_B_OP_ONE   6
+#define S_B_OP_COPY  7
+#define S_B_OP_ANDNOT 8
+
+// INTERNAL USE
+// applies op to map blocks 0 .. num-1 of dst(and src1, src2 where used)
+// returns the number of one bits of the result for and, or, xor and count, 0 otherwise
+static bit_index map_blocks_sweep (unsigned char op, map_block* dst, map_block* src1, map_block* src2, bit_index num) {
+   bit_index i;
+   
+   bit_index ones = 0;
+   
+   // plain loops over whole blocks, one per operation, so the compiler can vectorise them
+   switch (op) {
+      case S_B_OP_AND :
+         for (i = 0; i < num; i++) {
+            dst[i] = src1[i] & src2[i];
+            ones += s_b_popcount(dst[i]);
          }
-         else if (default_val) {
-            bitmap_one(map);
+         break;
+      case S_B_OP_OR :
+         for (i = 0; i < num; i++) {
+            dst[i] = src1[i] | src2[i];
+            ones += s_b_popcount(dst[i]);
          }
-         else {
-            bitmap_zero(map);
+         break;
+      case S_B_OP_XOR :
+         for (i = 0; i < num; i++) {
+            dst[i] = src1[i] ^ src2[i];
+            ones += s_b_popcount(dst[i]);
          }
-         return 0;
-      }
-      
-      if (direction >= 0) {
-         start = map->end - blocks_to_shift;
-         start1 = map->end;
-         
-         for (; start1 >= map->base; start--, start1--) {
-            *start1 = *start;
-         }
-         
-         start = map->base + blocks_to_shift - 1;
-         
-         // overwrite remaining blocks with default value
-         if (default_val > 1) {
-            ; // do nothing
-         }
-         else {
-            if (default_val == 1) {
-               temp = (map_block) -1;
-            }
-            else {
-               temp = 0;
-            }
-            for (; start >= map->base; start--) {
-               *start = temp;
-            }
-         }
-      }
-      else {
-         start = map->base;
-         start1 = map->base + blocks_to_shift;
-         
-         for (; start1 <= map->end; start++, start1++) {
-            *start = *start1;
+         break;
+      case S_B_OP_NOT :
+         for (i = 0; i < num; i++) {
+            dst[i] = ~dst[i];
          }
-         
-         start = map->end - blocks_to_shift + 1;
-         
-         // overwrite remaining blocks with default value
-         if (default_val > 1) {
-            ; // do nothing
+         break;
+      case S_B_OP_COUNT :
+         for (i = 0; i < num; i++) {
+            ones += s_b_popcount(dst[i]);
          }
-         else {
-            if (default_val == 1) {
-               temp = (map_block) -1;
-            }
-            else {
-               temp = 0;
-            }
-            for (; start <= map->end; start++) {
-               *start = temp;
-            }
+         break;
+      case S_B_OP_ZERO :
+         memset(dst, 0x00, sizeof(map_block) * num);
+         break;
+      case S_B_OP_ONE :
+         memset(dst, 0xFF, sizeof(map_block) * num);
+         break;
+      default :
+         for (i = 0; i < num; i++) {
+            dst[i] = src1[i];
          }
-      }
+         break;
    }
-   else {      // need to rotate
-      if (blocks_to_shift >= map->length) {
-         blocks_to_shift = blocks_to_shift % get_bitmap_map_block_number(map->length);
+   
+   return ones;
+}
+
+#ifdef SIMPLE_BITMAP_PARALLEL
+#define S_B_CACHE_LINE  64
+
+static pthread_mutex_t s_b_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_b_pool_work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t s_b_pool_done_cond = PTHREAD_COND_INITIALIZER;
+
+// held by whoever is using the pool, including init and shutdown
+static pthread_mutex_t s_b_pool_busy = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t s_b_pool_threads[SIMPLE_BITMAP_PARALLEL_MAX_THREADS];
+static int s_b_pool_thread_count;      // counting the calling thread, 0 if not running
+static int s_b_pool_stop;
+static unsigned long s_b_pool_generation;    // bumped for every sweep handed to the pool
+static unsigned long s_b_pool_init_generation;
+static int s_b_pool_pending;           // workers yet to finish the current sweep
+
+// the current sweep
+static unsigned char s_b_pool_op;
+static map_block* s_b_pool_dst;
+static map_block* s_b_pool_src1;
+static map_block* s_b_pool_src2;
+static bit_index s_b_pool_num;
+static bit_index s_b_pool_lead;        // map blocks of dst before its first cache line boundary
+static bit_index s_b_pool_chunk;       // multiple of a cache line
+static struct {
+   bit_index ones;
+   char padding[S_B_CACHE_LINE - sizeof(bit_index)];     // one partial count per cache line
+} s_b_pool_partial[SIMPLE_BITMAP_PARALLEL_MAX_THREADS];
+
+// INTERNAL USE
+// chunk id covers map blocks [lead + id * chunk, lead + (id+1) * chunk),
+// except that the first chunk starts at 0 and the last one ends at num
+static void map_blocks_parallel_chunk (int id) {
+   bit_index from;
+   bit_index to;
+   
+   from = id == 0 ? 0 : s_b_min(s_b_pool_num, s_b_pool_lead + id * s_b_pool_chunk);
+   to = id == s_b_pool_thread_count - 1 ? s_b_pool_num : s_b_min(s_b_pool_num, s_b_pool_lead + (id + 1) * s_b_pool_chunk);
+   
+   s_b_pool_partial[id].ones =
+      map_blocks_sweep(s_b_pool_op,
+                       s_b_pool_dst + from,
+                       s_b_pool_src1 == NULL ? NULL : s_b_pool_src1 + from,
+                       s_b_pool_src2 == NULL ? NULL : s_b_pool_src2 + from,
+                       to - from);
+}
+
+static void* map_blocks_parallel_worker (void* arg) {
+   int id = (int) (intptr_t) arg;
+   
+   unsigned long seen;
+   
+   pthread_mutex_lock(&s_b_pool_lock);
+   
+   seen = s_b_pool_init_generation;
+   
+   for (;;) {
+      while (!s_b_pool_stop && s_b_pool_generation == seen) {
+         pthread_cond_wait(&s_b_pool_work_cond, &s_b_pool_lock);
       }
+      if (s_b_pool_stop) {
+         break;
+      }
+      seen = s_b_pool_generation;
       
-      start = map->base;
-      end = map->end;
+      pthread_mutex_unlock(&s_b_pool_lock);
       
-      move_count = s_b_min(blocks_to_shift, get_bitmap_map_block_number(map->length) - blocks_to_shift);
+      map_blocks_parallel_chunk(id);
       
-      // main rotation algorithm begins
-      if (direction >= 0) {
-         if (move_count == blocks_to_shift) {
-            shrink_direction = 1;
-         }
-         else {
-            shrink_direction = -1;
-         }
-      }
-      else {
-         if (move_count == blocks_to_shift) {
-            shrink_direction = -1;
-         }
-         else {
-            shrink_direction = 1;
-         }
-      }
+      pthread_mutex_lock(&s_b_pool_lock);
       
-      while (start < end) {
-         map_blocks_ferris_wheel_flip(start, end, move_count);
-         
-         if (shrink_direction == 1) {
-            start += move_count;
-         }
-         else {
-            end -= move_count;
-         }
-         
-         if (start - end < 2 * move_count) { // need to flip direction and reduce unit
-            shrink_direction *= -1;
-            // move_count = min(move_count, start - end + 1 - move_count);
-            move_count = start - end + 1 - move_count;
-         }
-      }
-      // main rotation algorithm ends
-      
-      // handle the bitwise mismatching
-      if (get_bitmap_excess_bits(map->length)) {
-         if (direction >= 0) {   // shift to right
-            // handle the remaining unshifted blocks
-            for (cur = map->base+blocks_to_shift-1;
-                  cur > map->base; cur--) {
-               temp = *(cur-1) << get_bitmap_excess_bits(map->length);
-               
-               *cur >>= MAP_BLOCK_BIT - get_bitmap_excess_bits(map->length);
-               *cur |= temp;
-            }
-            
-            // handle the last block
-            temp = (*(map->end) << get_bitmap_excess_bits(map->length));
-            
-            *(map->base) >>= MAP_BLOCK_BIT - get_bitmap_excess_bits(map->length);
-            *(map->base) |= temp;
-         }
-         else {      // shift to left
-            // handle the previously last block
-            temp = *(map->end-blocks_to_shift+1) >> get_bitmap_excess_bits(map->length);
-            
-            *(map->end-blocks_to_shift) |= temp;
-            
-            // shift remaining blocks to left including the currently last block
-            for (cur = map->end-blocks_to_shift+1;
-                  cur < map->end; cur++) {
-               temp = *(cur+1) >> get_bitmap_excess_bits(map->length);
-               
-               *cur <<= MAP_BLOCK_BIT - get_bitmap_excess_bits(map->length);
-               *cur |= temp;
-            }
-            
-            // handle the last block
-            *(map->end) <<= MAP_BLOCK_BIT - get_bitmap_excess_bits(map->length);
-         }
+      if (--s_b_pool_pending == 0) {
+         pthread_cond_signal(&s_b_pool_done_cond);
       }
    }
    
-   bitmap_count_zeros_and_ones(map);
+   pthread_mutex_unlock(&s_b_pool_lock);
    
-   bitshift:
-   if (bits_to_shift == 0) {
-      return 0;
+   return NULL;
+}
+
+// INTERNAL USE
+// same as map_blocks_sweep, but split over the pool when it is worth it
+static bit_index map_blocks_parallel_sweep (unsigned char op, map_block* dst, map_block* src1, map_block* src2, bit_index num) {
+   bit_index line = S_B_CACHE_LINE / sizeof(map_block);
+   
+   bit_index ones;
+   
+   int i;
+   
+   if (num < SIMPLE_BITMAP_PARALLEL_THRESHOLD / MAP_BLOCK_BIT) {
+      return map_blocks_sweep(op, dst, src1, src2, num);
    }
    
-   if (!wrap_around) {  // no need to recycle
-      if (direction >= 0) {   // shift to right
-         for (cur = map->end; cur > map->base; cur--) {
-            *cur >>= bits_to_shift;
-            
-            *cur |= (*(cur-1) << (MAP_BLOCK_BIT - bits_to_shift));
-         }
-         
-         *(map->base) >>= bits_to_shift;
-      }
-      else {      // shift to left
-         for (cur = map->base; cur < map->end; cur++) {
-            *cur <<= bits_to_shift;
-            
-            *cur |= (*(cur+1) >> (MAP_BLOCK_BIT - bits_to_shift));
-         }
-         
-         *(map->end) <<= bits_to_shift;
-      }
+   // somebody else is using the pool
+   if (pthread_mutex_trylock(&s_b_pool_busy) != 0) {
+      return map_blocks_sweep(op, dst, src1, src2, num);
    }
-   else {   // need to rotate
-      if (direction >= 0) {   // shift to right
-         temp = *(map->end);
-         
-         for (cur = map->end; cur > map->base; cur--) {
-            *cur >>= bits_to_shift;
-            
-            *cur |= (*(cur-1) << (MAP_BLOCK_BIT - bits_to_shift));
-         }
-         
-         *(map->base) >>= bits_to_shift;
-         
-         // piece the previous last block into the start first
-         if (bits_to_shift < get_bitmap_map_block_bit_index(map->length-1)+1) {
-            temp <<= get_bitmap_excess_bits(map->length) - bits_to_shift;
-         }
-         else {
-            temp >>= bits_to_shift - get_bitmap_excess_bits(map->length);
-            temp |= *(map->end) << get_bitmap_excess_bits(map->length);
-         }
-         
-         *(map->base) |= temp;
-      }
-      else {      // shift to left
-         temp = *(map->base);
-         
-         for (cur = map->base; cur < map->end; cur++) {
-            *cur <<= bits_to_shift;
-            
-            *cur |= (*(cur+1) >> (MAP_BLOCK_BIT - bits_to_shift));
-         }
-         
-         *(map->end) <<= bits_to_shift;
-         
-         // piece the previous first block into the end
-         if (bits_to_shift < get_bitmap_excess_bits(map->length)) {
-            temp >>= get_bitmap_excess_bits(map->length) - bits_to_shift;
-            
-            *(map->end) |= temp;
-         }
-         else {
-            *(map->end-1) |= temp >> (MAP_BLOCK_BIT - (bits_to_shift - get_bitmap_excess_bits(map->length)));
-            *(map->end) |= temp << (bits_to_shift - get_bitmap_excess_bits(map->length));
-         }
+   
+   // overlapping copies depend on the order blocks are copied in
+   if (s_b_pool_thread_count < 2
+         || (op == S_B_OP_COPY && src1 < dst + num && dst < src1 + num))
+   {
+      pthread_mutex_unlock(&s_b_pool_busy);
+      return map_blocks_sweep(op, dst, src1, src2, num);
+   }
+   
+   s_b_pool_op = op;
+   s_b_pool_dst = dst;
+   s_b_pool_src1 = src1;
+   s_b_pool_src2 = src2;
+   s_b_pool_num = num;
+   
+   // chunk boundaries fall on cache lines of dst, so no two threads write to the same line
+   s_b_pool_lead = (S_B_CACHE_LINE - (uintptr_t) dst % S_B_CACHE_LINE) % S_B_CACHE_LINE / sizeof(map_block);
+   s_b_pool_chunk = (num / s_b_pool_thread_count + line - 1) / line * line;
+   
+   pthread_mutex_lock(&s_b_pool_lock);
+   s_b_pool_pending = s_b_pool_thread_count - 1;
+   s_b_pool_generation++;
+   pthread_cond_broadcast(&s_b_pool_work_cond);
+   pthread_mutex_unlock(&s_b_pool_lock);
+   
+   map_blocks_parallel_chunk(0);
+   
+   pthread_mutex_lock(&s_b_pool_lock);
+   while (s_b_pool_pending > 0) {
+      pthread_cond_wait(&s_b_pool_done_cond, &s_b_pool_lock);
+   }
+   pthread_mutex_unlock(&s_b_pool_lock);
+   
+   // merge the partial counts
+   ones = 0;
+   for (i = 0; i < s_b_pool_thread_count; i++) {
+      ones += s_b_pool_partial[i].ones;
+   }
+   
+   pthread_mutex_unlock(&s_b_pool_busy);
+   
+   return ones;
+}
+
+int bitmap_parallel_init (int thread_count) {
+   int i;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (thread_count < 1 || thread_count > SIMPLE_BITMAP_PARALLEL_MAX_THREADS) {
+      printf("bitmap_parallel_init : thread_count must be between 1 and %d\n", SIMPLE_BITMAP_PARALLEL_MAX_THREADS);
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   pthread_mutex_lock(&s_b_pool_busy);
+   
+   if (s_b_pool_thread_count != 0) {
+      pthread_mutex_unlock(&s_b_pool_busy);
+      printf("bitmap_parallel_init : pool is already running\n");
+      return GENERAL_FAIL;
+   }
+   
+   pthread_mutex_lock(&s_b_pool_lock);
+   s_b_pool_stop = 0;
+   s_b_pool_init_generation = s_b_pool_generation;
+   pthread_mutex_unlock(&s_b_pool_lock);
+   
+   for (i = 1; i < thread_count; i++) {
+      if (pthread_create(&s_b_pool_threads[i], NULL, map_blocks_parallel_worker, (void*) (intptr_t) i) != 0) {
+         break;
       }
    }
    
-   bitmap_count_zeros_and_ones(map);
+   // run with however many threads could be started
+   s_b_pool_thread_count = i;
    
-   bitmap_meta_encrypt(map);
+   pthread_mutex_unlock(&s_b_pool_busy);
+   
+   if (i < thread_count) {
+      printf("bitmap_parallel_init : only %d of %d threads could be started\n", i, thread_count);
+      return GENERAL_FAIL;
+   }
    
    return 0;
 }
 
-int bitmap_not (simple_bitmap* map) {
-   map_block* cur;
+int bitmap_parallel_shutdown (void) {
+   int i;
    
-   unsigned char count;
+   pthread_mutex_lock(&s_b_pool_busy);
    
+   pthread_mutex_lock(&s_b_pool_lock);
+   s_b_pool_stop = 1;
+   pthread_cond_broadcast(&s_b_pool_work_cond);
+   pthread_mutex_unlock(&s_b_pool_lock);
+   
+   for (i = 1; i < s_b_pool_thread_count; i++) {
+      pthread_join(s_b_pool_threads[i], NULL);
+   }
+   
+   s_b_pool_thread_count = 0;
+   
+   pthread_mutex_unlock(&s_b_pool_busy);
+   
+   return 0;
+}
+#else
+   #define map_blocks_parallel_sweep map_blocks_sweep
+#endif
+
+int bitmap_data_check (simple_bitmap* map) {
    map_block mask;
    
-   bit_index temp;
+   bit_index ones;
    
    bitmap_meta_decrypt(map);
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
    if (map == NULL) {
-      printf("bitmap_not : map is NULL\n");
-      return WRONG_INPUT;
+      printf("bitmap_data_check : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
    }
+   #endif
+   
    if (map->base == NULL) {
-      printf("bitmap_not : base is NULL\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_data_check : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
    if (map->end == NULL) {
-      printf("bitmap_not : end is NULL\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_data_check : end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
    if (map->length == 0) {
-      printf("bitmap_not : map has no length\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_data_check : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
    if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_not : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_data_check : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
    if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_not : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_data_check : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   #endif
    
-   // flip bits
-   for (cur = map->base; cur <= map->end; cur++) {
-      *cur = ~(*cur);
+   // padding bits must be 0s
+   mask = s_b_head_mask(get_bitmap_map_block_bit_index(map->length-1) + 1);
+   if (*(map->end) & ~mask) {
+      printf("bitmap_data_check : padding bits of the last map block are not 0s\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
    
-   // clean up the edge
-   mask = 0;
-   for (count = 0; count <= get_bitmap_map_block_bit_index(map->length-1); count++) {
-      mask |= 0x1 << (MAP_BLOCK_BIT - count - 1);
+   ones = map_blocks_parallel_sweep(S_B_OP_COUNT, map->base, NULL, NULL, map->end - map->base + 1);
+   if (ones != map->number_of_ones) {
+      printf("bitmap_data_check : number of ones does not match the map\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   *(map->end) &= mask;
-   
-   // switch numbers
-   temp = map->number_of_ones;
-   map->number_of_ones = map->number_of_zeros;
-   map->number_of_zeros = temp;
    
    bitmap_meta_encrypt(map);
    
    return 0;
 }
 
-int bitmap_and (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map, unsigned char enforce_same_size) {
-   map_block* cur1;
-   map_block* cur2;
-   map_block* cur_ret;
+int bitmap_zero (simple_bitmap* map) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_zero : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_zero : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_zero : end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_zero : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   #endif
+   
+   // write 0s
+   map_blocks_parallel_sweep(S_B_OP_ZERO, map->base, NULL, NULL, map->end - map->base + 1);
    
-   //unsigned char count;
+   map->number_of_zeros = map->length;
+   map->number_of_ones = 0;
    
-   //map_block mask;
+   if (map->summary != NULL) {
+      map_blocks_summary_rebuild(map);
+   }
+   s_b_rank_touch_all(map);
    
-   //bit_index temp;
+   bitmap_meta_encrypt(map);
    
-   bitmap_meta_decrypt(map1);
-   bitmap_meta_decrypt(map2);
-   bitmap_meta_decrypt(ret_map);
+   return 0;
+}
+
+int bitmap_one (simple_bitmap* map) {
+   map_block mask;
+   
+   //map_block buf;
+   
+   map_block* cur;
+   
+   bitmap_meta_decrypt(map);
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map1 == NULL) {
-      printf("bitmap_and : map1 is NULL\n");
-      return WRONG_INPUT;
+   if (map == NULL) {
+      printf("bitmap_one : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
    }
-   if (map1->base == NULL) {
-      printf("bitmap_and : map1->base is NULL\n");
-      return CORRUPTED_DATA;
+   if (map->base == NULL) {
+      printf("bitmap_one : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   if (map1->end == NULL) {
-      printf("bitmap_and : map1->end is NULL\n");
-      return CORRUPTED_DATA;
+   if (map->end == NULL) {
+      printf("bitmap_one : end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   if (map1->length == 0) {
-      printf("bitmap_and : map1 has no length\n");
-      return CORRUPTED_DATA;
+   if (map->length == 0) {
+      printf("bitmap_one : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
-      printf("bitmap_and : map1 : is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   #endif
+   
+   // write 1s
+   map_blocks_parallel_sweep(S_B_OP_ONE, map->base, NULL, NULL, map->end - map->base + 1);
+   
+   cur = map->end;
+   
+   // set the extra bits back to 0
+   mask = s_b_head_mask(get_bitmap_map_block_bit_index(map->length-1) + 1);
+   *cur &= mask;
+   
+   map->number_of_zeros = 0;
+   map->number_of_ones = map->length;
+   
+   if (map->summary != NULL) {
+      map_blocks_summary_rebuild(map);
    }
-   if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
-      printf("bitmap_and : map1 : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   s_b_rank_touch_all(map);
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+// 64 bits starting at a map block, most significant bit first, regardless of map block size
+#if SIMPLE_BITMAP_MAP_BLOCK_BIT == 64
+   #define s_b_word_load(blocks) ((uint64_t) *(blocks))
+   #define s_b_word_store(blocks, word) (*(blocks) = (map_block) (word))
+#elif SIMPLE_BITMAP_MAP_BLOCK_BIT == 32
+   #define s_b_word_load(blocks) (((uint64_t) (blocks)[0] << 32) | (uint64_t) (blocks)[1])
+   #define s_b_word_store(blocks, word) ((blocks)[0] = (map_block) ((word) >> 32), (blocks)[1] = (map_block) (word))
+#else
+   #define s_b_word_load(blocks) s_b_word_load_bytes(blocks)
+   #define s_b_word_store(blocks, word) s_b_word_store_bytes(blocks, word)
+
+static uint64_t s_b_word_load_bytes (map_block* blocks) {
+   uint64_t word;
+   
+   #if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   memcpy(&word, blocks, sizeof(uint64_t));
+   word = __builtin_bswap64(word);
+   #elif defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+   memcpy(&word, blocks, sizeof(uint64_t));
+   #else
+   unsigned char i;
+   
+   for (word = 0, i = 0; i < 8; i++) {
+      word = (word << 8) | blocks[i];
    }
-   if (map2 == NULL) {
-      printf("bitmap_and : map2 is NULL\n");
-      return WRONG_INPUT;
+   #endif
+   
+   return word;
+}
+
+static void s_b_word_store_bytes (map_block* blocks, uint64_t word) {
+   #if defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   word = __builtin_bswap64(word);
+   memcpy(blocks, &word, sizeof(uint64_t));
+   #elif defined(__GNUC__) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+   memcpy(blocks, &word, sizeof(uint64_t));
+   #else
+   unsigned char i;
+   
+   for (i = 8; i > 0; i--) {
+      blocks[i-1] = (map_block) word;
+      word >>= 8;
    }
-   if (map2->base == NULL) {
-      printf("bitmap_and : map2->base is NULL\n");
-      return CORRUPTED_DATA;
-   }
-   if (map2->end == NULL) {
-      printf("bitmap_and : map2->end is NULL\n");
-      return CORRUPTED_DATA;
-   }
-   if (map2->length == 0) {
-      printf("bitmap_and : map2 has no length\n");
-      return CORRUPTED_DATA;
-   }
-   if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
-      printf("bitmap_and : map2 : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
-   }
-   if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
-      printf("bitmap_and : map2 : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
-   }
-   if (ret_map == NULL) {
-      printf("bitmap_and : ret_map is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (ret_map->base == NULL) {
-      printf("bitmap_and : ret_map->base is NULL\n");
-      return CORRUPTED_DATA;
+   #endif
+}
+#endif
+
+// number of map blocks making up a 64 bit word
+#define S_B_WORD_BLOCKS (64 / MAP_BLOCK_BIT)
+
+// number of indices bitmap_for_each_one decodes at a time
+#define S_B_DECODE_BUF_NUM 256
+
+// size of the fixed buffer bitmap_shift rotates through, in map blocks
+#define S_B_SHIFT_BUF_BLOCKS (1024 / sizeof(map_block))
+#define S_B_SHIFT_BUF_BIT (S_B_SHIFT_BUF_BLOCKS * MAP_BLOCK_BIT)
+
+// INTERNAL USE
+// reads count(1 to MAP_BLOCK_BIT) bits starting at bit index from,
+// returned in the most significant bits of the map block
+static map_block map_blocks_read_bits (map_block* blocks, bit_index from, unsigned char count) {
+   map_block* cur = blocks + get_bitmap_map_block_index(from);
+   
+   unsigned char bit = get_bitmap_map_block_bit_index(from);
+   
+   map_block val = *cur << bit;
+   
+   if (bit + count > MAP_BLOCK_BIT) {
+      val |= *(cur+1) >> (MAP_BLOCK_BIT - bit);
    }
-   if (ret_map->end == NULL) {
-      printf("bitmap_and : ret_map->end is NULL\n");
-      return CORRUPTED_DATA;
+   
+   return val & s_b_head_mask(count);
+}
+
+// INTERNAL USE
+// writes the count(1 to MAP_BLOCK_BIT) most significant bits of val starting at bit index to,
+// the bits written must lie within one map block
+static void map_blocks_write_bits (map_block* blocks, bit_index to, map_block val, unsigned char count) {
+   map_block* cur = blocks + get_bitmap_map_block_index(to);
+   
+   unsigned char bit = get_bitmap_map_block_bit_index(to);
+   
+   map_block mask = s_b_head_mask(count) >> bit;
+   
+   *cur = (*cur & ~mask) | ((val >> bit) & mask);
+}
+
+// INTERNAL USE
+// number of one bits in count bits starting at bit index from
+static bit_index map_blocks_count_bits (map_block* blocks, bit_index from, bit_index count) {
+   bit_index ones = 0;
+   
+   unsigned char chunk;
+   
+   bit_index first;
+   bit_index last;
+   bit_index cur;
+   
+   if (count == 0) {
+      return 0;
    }
-   if (ret_map->length == 0) {
-      printf("bitmap_and : ret_map has no length\n");
-      return CORRUPTED_DATA;
+   
+   // leading bits up to the first map block boundary
+   if (get_bitmap_map_block_bit_index(from)) {
+      chunk = s_b_min(count, MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(from));
+      ones += s_b_popcount(map_blocks_read_bits(blocks, from, chunk));
+      from += chunk;
+      count -= chunk;
    }
-   if (ret_map->base + get_bitmap_map_block_index(ret_map->length-1) != ret_map->end) {
-      printf("bitmap_and : ret_map : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   
+   // whole map blocks, 64 bits at a time
+   first = get_bitmap_map_block_index(from);
+   last = first + count / MAP_BLOCK_BIT;
+   for (cur = first; cur + S_B_WORD_BLOCKS <= last; cur += S_B_WORD_BLOCKS) {
+      ones += s_b_popcount64(s_b_word_load(blocks + cur));
    }
-   if (ret_map->number_of_zeros + ret_map->number_of_ones != ret_map->length) {
-      printf("bitmap_and : ret_map : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   for (; cur < last; cur++) {
+      ones += s_b_popcount(blocks[cur]);
    }
    
-   if (enforce_same_size) {
-      if (!(map1->length == map2->length == ret_map->length)) {
-         printf("bitmap_and : map1 and map2 have different sizes\n");
-         return WRONG_INPUT;
-      }
+   // trailing bits
+   if (count % MAP_BLOCK_BIT) {
+      ones += s_b_popcount(map_blocks_read_bits(blocks, last * MAP_BLOCK_BIT, count % MAP_BLOCK_BIT));
    }
-   #endif
    
-   // do AND bitwise operation
-   for (cur1 = map1->base, cur2 = map2->base, cur_ret = ret_map->base;
-         cur1 <= map1->end || cur2 <= map2->end || cur_ret <= ret_map->end;
-         cur1++, cur2++, cur_ret++) {
-      *cur_ret = *cur1 & *cur2;
+   return ones;
+}
+
+// INTERNAL USE
+// sets count bits starting at bit index from to val(0 or 1)
+static void map_blocks_fill_bits (map_block* blocks, bit_index from, bit_index count, map_block val) {
+   map_block fill = val ? (map_block) -1 : 0;
+   
+   unsigned char chunk;
+   
+   bit_index first;
+   bit_index last;
+   
+   if (count == 0) {
+      return;
    }
    
-   bitmap_count_zeros_and_ones(ret_map);
+   if (get_bitmap_map_block_bit_index(from)) {
+      chunk = s_b_min(count, MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(from));
+      map_blocks_write_bits(blocks, from, fill, chunk);
+      from += chunk;
+      count -= chunk;
+   }
    
-   bitmap_meta_encrypt(map1);
-   bitmap_meta_encrypt(map2);
-   bitmap_meta_encrypt(ret_map);
+   first = get_bitmap_map_block_index(from);
+   last = first + count / MAP_BLOCK_BIT;
+   if (last > first) {
+      memset(blocks + first, val ? 0xFF : 0x00, sizeof(map_block) * (last - first));
+   }
    
-   return 0;
+   if (count % MAP_BLOCK_BIT) {
+      map_blocks_write_bits(blocks, last * MAP_BLOCK_BIT, fill, count % MAP_BLOCK_BIT);
+   }
 }
 
-int bitmap_or (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map, unsigned char enforce_same_size) {
-   map_block* cur1;
-   map_block* cur2;
-   map_block* cur_ret;
+// INTERNAL USE
+// copies count bits from src starting at bit index from to dst starting at bit index to,
+// the ranges may overlap, same as memmove
+// only bits within the destination range are written
+static void map_blocks_move_bits (map_block* dst, bit_index to, map_block* src, bit_index from, bit_index count) {
+   unsigned char head;
+   unsigned char tail;
    
-   //unsigned char count;
+   unsigned char shift;
    
-   //map_block mask;
+   bit_index first;     // first whole destination map block
+   bit_index last;      // one past the last whole destination map block
+   bit_index cur;
+   bit_index src_cur;
    
-   //bit_index temp;
+   char forward;
    
-   bitmap_meta_decrypt(map1);
-   bitmap_meta_decrypt(map2);
-   bitmap_meta_decrypt(ret_map);
+   uint64_t word;
    
-   // input check
-   #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map1 == NULL) {
-      printf("bitmap_or : map1 is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map1->base == NULL) {
-      printf("bitmap_or : map1->base is NULL\n");
-      return CORRUPTED_DATA;
-   }
-   if (map1->end == NULL) {
-      printf("bitmap_or : map1->end is NULL\n");
-      return CORRUPTED_DATA;
+   if (count == 0 || (dst == src && to == from)) {
+      return;
    }
-   if (map1->length == 0) {
-      printf("bitmap_or : map1 has no length\n");
-      return CORRUPTED_DATA;
-   }
-   if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
-      printf("bitmap_or : map1 : is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
-   }
-   if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
-      printf("bitmap_or : map1 : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
-   }
-   if (map2 == NULL) {
-      printf("bitmap_or : map2 is NULL\n");
-      return WRONG_INPUT;
+   
+   // split the destination into a partial head block, whole blocks, and a partial tail block
+   head = get_bitmap_map_block_bit_index(to) ? s_b_min(count, MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(to)) : 0;
+   first = get_bitmap_map_block_index(to + head);
+   last = first + (count - head) / MAP_BLOCK_BIT;
+   tail = (count - head) % MAP_BLOCK_BIT;
+   
+   // source bit landing on the start of the first whole destination block
+   src_cur = from + head;
+   shift = get_bitmap_map_block_bit_index(src_cur);
+   src_cur = get_bitmap_map_block_index(src_cur);
+   
+   // copy in the direction that never overwrites source bits before they are read
+   forward = (dst != src || to < from);
+   
+   if (forward && head) {
+      map_blocks_write_bits(dst, to, map_blocks_read_bits(src, from, head), head);
    }
-   if (map2->base == NULL) {
-      printf("bitmap_or : map2->base is NULL\n");
-      return CORRUPTED_DATA;
+   if (!forward && tail) {
+      map_blocks_write_bits(dst, last * MAP_BLOCK_BIT, map_blocks_read_bits(src, from + count - tail, tail), tail);
    }
-   if (map2->end == NULL) {
-      printf("bitmap_or : map2->end is NULL\n");
-      return CORRUPTED_DATA;
+   
+   if (last > first) {
+      if (shift == 0) {    // aligned, whole map blocks can be moved directly
+         memmove(dst + first, src + src_cur, sizeof(map_block) * (last - first));
+      }
+      else if (forward) {
+         // funnel shift 64 bits at a time, then finish the remaining map blocks
+         for (cur = first; cur + S_B_WORD_BLOCKS <= last; cur += S_B_WORD_BLOCKS, src_cur += S_B_WORD_BLOCKS) {
+            word = s_b_word_load(src + src_cur) << shift;
+            word |= (uint64_t) src[src_cur + S_B_WORD_BLOCKS] >> (MAP_BLOCK_BIT - shift);
+            s_b_word_store(dst + cur, word);
+         }
+         for (; cur < last; cur++, src_cur++) {
+            dst[cur] = (map_block) (src[src_cur] << shift) | (src[src_cur+1] >> (MAP_BLOCK_BIT - shift));
+         }
+      }
+      else {
+         src_cur += last - first;
+         for (cur = last; cur >= first + S_B_WORD_BLOCKS; ) {
+            cur -= S_B_WORD_BLOCKS;
+            src_cur -= S_B_WORD_BLOCKS;
+            word = s_b_word_load(src + src_cur) << shift;
+            word |= (uint64_t) src[src_cur + S_B_WORD_BLOCKS] >> (MAP_BLOCK_BIT - shift);
+            s_b_word_store(dst + cur, word);
+         }
+         while (cur > first) {
+            cur--;
+            src_cur--;
+            dst[cur] = (map_block) (src[src_cur] << shift) | (src[src_cur+1] >> (MAP_BLOCK_BIT - shift));
+         }
+      }
    }
-   if (map2->length == 0) {
-      printf("bitmap_or : map2 has no length\n");
-      return CORRUPTED_DATA;
+   
+   if (forward && tail) {
+      map_blocks_write_bits(dst, last * MAP_BLOCK_BIT, map_blocks_read_bits(src, from + count - tail, tail), tail);
    }
-   if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
-      printf("bitmap_or : map2 : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (!forward && head) {
+      map_blocks_write_bits(dst, to, map_blocks_read_bits(src, from, head), head);
    }
-   if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
-      printf("bitmap_or : map2 : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+}
+
+// INTERNAL USE
+// rotates count bits starting at bit index from to the left by offset(less than count) bits
+// the two parts are block swapped through a fixed buffer until the shorter part fits in the buffer,
+// which is then rotated around the longer part in a single move
+static void map_blocks_rotate_bits (map_block* blocks, bit_index from, bit_index count, bit_index offset) {
+   map_block buf[S_B_SHIFT_BUF_BLOCKS];
+   
+   bit_index left;
+   bit_index right;
+   
+   bit_index done;
+   bit_index chunk;
+   bit_index size;
+   bit_index pos1;
+   bit_index pos2;
+   
+   while (offset != 0 && offset != count) {
+      left = offset;
+      right = count - offset;
+      
+      if (left <= S_B_SHIFT_BUF_BIT) {
+         map_blocks_move_bits(buf, 0, blocks, from, left);
+         map_blocks_move_bits(blocks, from, blocks, from + left, right);
+         map_blocks_move_bits(blocks, from + right, buf, 0, left);
+         return;
+      }
+      if (right <= S_B_SHIFT_BUF_BIT) {
+         map_blocks_move_bits(buf, 0, blocks, from + left, right);
+         map_blocks_move_bits(blocks, from + right, blocks, from, left);
+         map_blocks_move_bits(blocks, from, buf, 0, right);
+         return;
+      }
+      
+      // swap the shorter part with the far end of the longer part,
+      // which puts the shorter part in its final place
+      chunk = s_b_min(left, right);
+      for (done = 0; done < chunk; done += S_B_SHIFT_BUF_BIT) {
+         size = s_b_min(S_B_SHIFT_BUF_BIT, chunk - done);
+         pos1 = from + done;
+         pos2 = from + count - chunk + done;
+         
+         map_blocks_move_bits(buf, 0, blocks, pos1, size);
+         map_blocks_move_bits(blocks, pos1, blocks, pos2, size);
+         map_blocks_move_bits(blocks, pos2, buf, 0, size);
+      }
+      
+      if (left <= right) {    // A B1 B2 -> B2 B1 A, rotate B2 B1 next
+         count -= left;
+      }
+      else {                  // A1 A2 B -> B A2 A1, rotate A2 A1 next
+         from += right;
+         count -= right;
+         offset -= right;
+      }
    }
-   if (ret_map == NULL) {
-      printf("bitmap_or : ret_map is NULL\n");
-      return WRONG_INPUT;
+}
+
+int bitmap_shift (simple_bitmap* map, bit_index offset, char direction, map_block default_val, unsigned char wrap_around) {
+   bit_index kept;      // bits that are moved and stay within the map
+   
+   bit_index vacated_from;
+   
+   bit_index ones;
+   
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_shift : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
    }
-   if (ret_map->base == NULL) {
-      printf("bitmap_or : ret_map->base is NULL\n");
-      return CORRUPTED_DATA;
+   if (map->base == NULL) {
+      printf("bitmap_shift : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   if (ret_map->end == NULL) {
-      printf("bitmap_or : ret_map->end is NULL\n");
-      return CORRUPTED_DATA;
+   if (map->end == NULL) {
+      printf("bitmap_shift : end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   if (ret_map->length == 0) {
-      printf("bitmap_or : ret_map has no length\n");
-      return CORRUPTED_DATA;
+   if (map->length == 0) {
+      printf("bitmap_shift : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   if (ret_map->base + get_bitmap_map_block_index(ret_map->length-1) != ret_map->end) {
-      printf("bitmap_or : ret_map : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_shift : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   if (ret_map->number_of_zeros + ret_map->number_of_ones != ret_map->length) {
-      printf("bitmap_or : ret_map : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_shift : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
+   #endif
    
-   if (enforce_same_size) {
-      if (!(map1->length == map2->length == ret_map->length)) {
-         printf("bitmap_or : map1 and map2 have different sizes\n");
-         return WRONG_INPUT;
+   if (wrap_around) {      // rotation keeps every bit, so statistics stay the same
+      offset %= map->length;
+      
+      if (offset == 0) {
+         bitmap_meta_encrypt(map);
+         return 0;
+      }
+      
+      // rotating to the right is rotating to the left by the rest of the map
+      if (direction >= 0) {
+         offset = map->length - offset;
       }
+      
+      map_blocks_rotate_bits(map->base, 0, map->length, offset);
    }
-   #endif
-   
-   // do OR bitwise operation
-   for (cur1 = map1->base, cur2 = map2->base, cur_ret = ret_map->base;
-         cur1 <= map1->end || cur2 <= map2->end || cur_ret <= ret_map->end;
-         cur1++, cur2++, cur_ret++) {
-      *cur_ret = *cur1 | *cur2;
+   else {
+      if (offset == 0) {
+         bitmap_meta_encrypt(map);
+         return 0;
+      }
+      
+      kept = offset < map->length ? map->length - offset : 0;
+      
+      // count the smaller one of the bits shifted out and the bits kept
+      if (kept == 0) {
+         ones = 0;
+      }
+      else if (offset <= kept) {
+         ones = map->number_of_ones - map_blocks_count_bits(map->base, direction >= 0 ? kept : 0, offset);
+      }
+      
+      if (direction >= 0) {   // shift to right
+         map_blocks_move_bits(map->base, map->length - kept, map->base, 0, kept);
+         vacated_from = 0;
+         
+         if (kept != 0 && offset > kept) {
+            ones = map_blocks_count_bits(map->base, map->length - kept, kept);
+         }
+      }
+      else {                  // shift to left
+         map_blocks_move_bits(map->base, 0, map->base, map->length - kept, kept);
+         vacated_from = kept;
+         
+         if (kept != 0 && offset > kept) {
+            ones = map_blocks_count_bits(map->base, 0, kept);
+         }
+      }
+      
+      // overwrite the new space with default value
+      if (default_val > 1) {
+         ones += map_blocks_count_bits(map->base, vacated_from, map->length - kept);
+      }
+      else {
+         map_blocks_fill_bits(map->base, vacated_from, map->length - kept, default_val);
+         
+         if (default_val) {
+            ones += map->length - kept;
+         }
+      }
+      
+      map->number_of_ones = ones;
+      map->number_of_zeros = map->length - ones;
    }
    
-   bitmap_count_zeros_and_ones(ret_map);
+   if (map->summary != NULL) {
+      map_blocks_summary_rebuild(map);
+   }
+   s_b_rank_touch_all(map);
    
-   bitmap_meta_encrypt(map1);
-   bitmap_meta_encrypt(map2);
-   bitmap_meta_encrypt(ret_map);
+   bitmap_meta_encrypt(map);
    
    return 0;
 }
 
-int bitmap_xor (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map, unsigned char enforce_same_size) {
-   map_block* cur1;
-   map_block* cur2;
-   map_block* cur_ret;
-   
-   //unsigned char count;
-   
-   //map_block mask;
+int bitmap_not (simple_bitmap* map) {
+   map_block mask;
    
-   //bit_index temp;
+   bit_index temp;
    
-   bitmap_meta_decrypt(map1);
-   bitmap_meta_decrypt(map2);
-   bitmap_meta_decrypt(ret_map);
+   bitmap_meta_decrypt(map);
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map1 == NULL) {
-      printf("bitmap_xor : map1 is NULL\n");
-      return WRONG_INPUT;
+   if (map == NULL) {
+      printf("bitmap_not : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
    }
-   if (map1->base == NULL) {
-      printf("bitmap_xor : map1->base is NULL\n");
-      return CORRUPTED_DATA;
+   if (map->base == NULL) {
+      printf("bitmap_not : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   if (map1->end == NULL) {
-      printf("bitmap_xor : map1->end is NULL\n");
-      return CORRUPTED_DATA;
+   if (map->end == NULL) {
+      printf("bitmap_not : end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
    }
-   if (map1->length == 0) {
-      printf("bitmap_xor : map1 has no length\n");
-      return CORRUPTED_DATA;
+   if (map->length == 0) {
+      printf("bitmap_not : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_not : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_not : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   #endif
+   
+   // flip bits
+   map_blocks_parallel_sweep(S_B_OP_NOT, map->base, NULL, NULL, map->end - map->base + 1);
+   
+   // clean up the edge
+   mask = s_b_head_mask(get_bitmap_map_block_bit_index(map->length-1) + 1);
+   *(map->end) &= mask;
+   
+   // switch numbers
+   temp = map->number_of_ones;
+   map->number_of_ones = map->number_of_zeros;
+   map->number_of_zeros = temp;
+   
+   if (map->summary != NULL) {
+      map_blocks_summary_rebuild(map);
+   }
+   s_b_rank_touch_all(map);
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+// computes ret = map1 op map2 and counts the one bits of ret in the same pass
+// map blocks of map1 and map2 past their ends are treated as 0
+static bit_index map_blocks_logic_op (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map, unsigned char op) {
+   map_block* base1 = map1->base;
+   map_block* base2 = map2->base;
+   map_block* base_ret = ret_map->base;
+   
+   bit_index num1 = map1->end - map1->base + 1;
+   bit_index num2 = map2->end - map2->base + 1;
+   bit_index num_ret = ret_map->end - ret_map->base + 1;
+   
+   bit_index common;
+   bit_index i;
+   
+   bit_index ones;
+   
+   map_block buf1, buf2;
+   
+   common = s_b_min(s_b_min(num1, num2), num_ret - 1);
+   
+   ones = map_blocks_parallel_sweep(op, base_ret, base1, base2, common);
+   
+   // remaining blocks, where one of the inputs may have run out
+   for (i = common; i < num_ret; i++) {
+      buf1 = i < num1 ? base1[i] : 0;
+      buf2 = i < num2 ? base2[i] : 0;
+      
+      switch (op) {
+         case S_B_OP_AND :
+            base_ret[i] = buf1 & buf2;
+            break;
+         case S_B_OP_OR :
+            base_ret[i] = buf1 | buf2;
+            break;
+         default :
+            base_ret[i] = buf1 ^ buf2;
+            break;
+      }
+      
+      // clean up the edge
+      if (i == num_ret - 1) {
+         base_ret[i] &= s_b_head_mask(get_bitmap_map_block_bit_index(ret_map->length-1) + 1);
+      }
+      
+      ones += s_b_popcount(base_ret[i]);
+   }
+   
+   return ones;
+}
+
+int bitmap_and (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map, unsigned char enforce_same_size) {
+   bit_index ones;
+   
+   bitmap_meta_decrypt(map1);
+   bitmap_meta_decrypt(map2);
+   bitmap_meta_decrypt(ret_map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map1 == NULL) {
+      printf("bitmap_and : map1 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
+   }
+   if (map1->base == NULL) {
+      printf("bitmap_and : map1->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map1->end == NULL) {
+      printf("bitmap_and : map1->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map1->length == 0) {
+      printf("bitmap_and : map1 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
-      printf("bitmap_xor : map1 : is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : map1 : is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
-      printf("bitmap_xor : map1 : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : map1 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (map2 == NULL) {
-      printf("bitmap_xor : map2 is NULL\n");
-      return WRONG_INPUT;
+      printf("bitmap_and : map2 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
    }
    if (map2->base == NULL) {
-      printf("bitmap_xor : map2->base is NULL\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : map2->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (map2->end == NULL) {
-      printf("bitmap_xor : map2->end is NULL\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : map2->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (map2->length == 0) {
-      printf("bitmap_xor : map2 has no length\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : map2 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
-      printf("bitmap_xor : map2 : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : map2 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
-      printf("bitmap_xor : map2 : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : map2 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (ret_map == NULL) {
-      printf("bitmap_xor : ret_map is NULL\n");
-      return WRONG_INPUT;
+      printf("bitmap_and : ret_map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
    }
    if (ret_map->base == NULL) {
-      printf("bitmap_xor : ret_map->base is NULL\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : ret_map->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (ret_map->end == NULL) {
-      printf("bitmap_xor : ret_map->end is NULL\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : ret_map->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (ret_map->length == 0) {
-      printf("bitmap_xor : ret_map has no length\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : ret_map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (ret_map->base + get_bitmap_map_block_index(ret_map->length-1) != ret_map->end) {
-      printf("bitmap_xor : ret_map : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : ret_map : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    if (ret_map->number_of_zeros + ret_map->number_of_ones != ret_map->length) {
-      printf("bitmap_xor : ret_map : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_and : ret_map : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
    
    if (enforce_same_size) {
-      if (!(map1->length == map2->length == ret_map->length)) {
-         printf("bitmap_xor : map1 and map2 have different sizes\n");
-         return WRONG_INPUT;
+      if (map1->length != map2->length || map1->length != ret_map->length) {
+         printf("bitmap_and : map1 and map2 have different sizes\n");
+         return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
       }
    }
    #endif
    
-   // do XOR bitwise operation
-   for (cur1 = map1->base, cur2 = map2->base, cur_ret = ret_map->base;
-         cur1 <= map1->end || cur2 <= map2->end || cur_ret <= ret_map->end;
-         cur1++, cur2++, cur_ret++) {
-      *cur_ret = *cur1 ^ *cur2;
-   }
+   // do AND bitwise operation and count the result in the same pass
+   ones = map_blocks_logic_op(map1, map2, ret_map, S_B_OP_AND);
    
-   bitmap_count_zeros_and_ones(ret_map);
+   ret_map->number_of_ones = ones;
+   ret_map->number_of_zeros = ret_map->length - ones;
+   
+   if (ret_map->summary != NULL) {
+      map_blocks_summary_rebuild(ret_map);
+   }
+   s_b_rank_touch_all(ret_map);
    
    bitmap_meta_encrypt(map1);
    bitmap_meta_encrypt(map2);
@@ -1213,1623 +1965,5225 @@ int bitmap_xor (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map
    return 0;
 }
 
-int bitmap_read (simple_bitmap* map, bit_index index, map_block* result, unsigned char no_auto_crypt) {
-   //map_block* cur;
-   
-   uint_fast32_t block_index;
-   unsigned char bit_indx;
-   
-   map_block mask;
-   
-   map_block buf;
+int bitmap_or (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map, unsigned char enforce_same_size) {
+   bit_index ones;
    
-   if (!no_auto_crypt) {
-      bitmap_meta_decrypt(map);
-   }
+   bitmap_meta_decrypt(map1);
+   bitmap_meta_decrypt(map2);
+   bitmap_meta_decrypt(ret_map);
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_read : map is NULL\n");
-      return WRONG_INPUT;
+   if (map1 == NULL) {
+      printf("bitmap_or : map1 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
    }
-   if (map->base == NULL) {
-      printf("bitmap_read : base is NULL\n");
-      return CORRUPTED_DATA;
+   if (map1->base == NULL) {
+      printf("bitmap_or : map1->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   if (map->end == NULL) {
-      printf("bitmap_read : end is NULL\n");
-      return CORRUPTED_DATA;
+   if (map1->end == NULL) {
+      printf("bitmap_or : map1->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   if (map->length == 0) {
-      printf("bitmap_read : map has no length\n");
-      return CORRUPTED_DATA;
+   if (map1->length == 0) {
+      printf("bitmap_or : map1 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_read : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
+      printf("bitmap_or : map1 : is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_read : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
+      printf("bitmap_or : map1 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   #endif
-   block_index = get_bitmap_map_block_index(index);
-   #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map->base + block_index > map->end || index >= map->length) {
-      printf("bitmap_read : index exceeds range\n");
-      return WRONG_INPUT;
+   if (map2 == NULL) {
+      printf("bitmap_or : map2 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
+   }
+   if (map2->base == NULL) {
+      printf("bitmap_or : map2->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map2->end == NULL) {
+      printf("bitmap_or : map2->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map2->length == 0) {
+      printf("bitmap_or : map2 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
+      printf("bitmap_or : map2 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
+      printf("bitmap_or : map2 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (ret_map == NULL) {
+      printf("bitmap_or : ret_map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
+   }
+   if (ret_map->base == NULL) {
+      printf("bitmap_or : ret_map->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (ret_map->end == NULL) {
+      printf("bitmap_or : ret_map->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (ret_map->length == 0) {
+      printf("bitmap_or : ret_map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (ret_map->base + get_bitmap_map_block_index(ret_map->length-1) != ret_map->end) {
+      printf("bitmap_or : ret_map : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (ret_map->number_of_zeros + ret_map->number_of_ones != ret_map->length) {
+      printf("bitmap_or : ret_map : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   #endif
-   bit_indx = get_bitmap_map_block_bit_index(index);
-   
-   mask = 0x1 << ((MAP_BLOCK_BIT - 1) - bit_indx);
    
-   buf = *(map->base + block_index) & mask;
+   if (enforce_same_size) {
+      if (map1->length != map2->length || map1->length != ret_map->length) {
+         printf("bitmap_or : map1 and map2 have different sizes\n");
+         return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
+      }
+   }
+   #endif
    
-   buf = buf >> ((MAP_BLOCK_BIT - 1) - bit_indx);
+   // do OR bitwise operation and count the result in the same pass
+   ones = map_blocks_logic_op(map1, map2, ret_map, S_B_OP_OR);
    
-   *result = buf;
+   ret_map->number_of_ones = ones;
+   ret_map->number_of_zeros = ret_map->length - ones;
    
-   if (!no_auto_crypt) {
-      bitmap_meta_encrypt(map);
+   if (ret_map->summary != NULL) {
+      map_blocks_summary_rebuild(ret_map);
    }
+   s_b_rank_touch_all(ret_map);
+   
+   bitmap_meta_encrypt(map1);
+   bitmap_meta_encrypt(map2);
+   bitmap_meta_encrypt(ret_map);
    
    return 0;
 }
 
-int bitmap_write (simple_bitmap* map, bit_index index, map_block input_value, unsigned char no_auto_crypt) {
-   //map_block* cur;
-   
-   uint_fast32_t block_index;
-   unsigned char bit_indx;
-   
-   map_block mask;
-   
-   map_block buf;
+int bitmap_xor (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map, unsigned char enforce_same_size) {
+   bit_index ones;
    
-   map_block original;
+   bitmap_meta_decrypt(map1);
+   bitmap_meta_decrypt(map2);
+   bitmap_meta_decrypt(ret_map);
    
-   if (!no_auto_crypt) {
-      bitmap_meta_decrypt(map);
-   }
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_write : map is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map->base == NULL) {
-      printf("bitmap_write : base is NULL\n");
-      return WRONG_INPUT;
+   if (map1 == NULL) {
+      printf("bitmap_xor : map1 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
    }
-   if (map->end == NULL) {
-      printf("bitmap_write : end is NULL\n");
-      return WRONG_INPUT;
+   if (map1->base == NULL) {
+      printf("bitmap_xor : map1->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   if (map->length == 0) {
-      printf("bitmap_write : map has no length\n");
-      return CORRUPTED_DATA;
+   if (map1->end == NULL) {
+      printf("bitmap_xor : map1->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_write : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (map1->length == 0) {
+      printf("bitmap_xor : map1 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_write : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
+      printf("bitmap_xor : map1 : is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   #endif
-   block_index = get_bitmap_map_block_index(index);
-   #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map->base + block_index > map->end || index >= map->length) {
-      printf("bitmap_write : index exceeds range\n");
-      return WRONG_INPUT;
+   if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
+      printf("bitmap_xor : map1 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map2 == NULL) {
+      printf("bitmap_xor : map2 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
+   }
+   if (map2->base == NULL) {
+      printf("bitmap_xor : map2->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map2->end == NULL) {
+      printf("bitmap_xor : map2->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map2->length == 0) {
+      printf("bitmap_xor : map2 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
+      printf("bitmap_xor : map2 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
+      printf("bitmap_xor : map2 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (ret_map == NULL) {
+      printf("bitmap_xor : ret_map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
+   }
+   if (ret_map->base == NULL) {
+      printf("bitmap_xor : ret_map->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (ret_map->end == NULL) {
+      printf("bitmap_xor : ret_map->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (ret_map->length == 0) {
+      printf("bitmap_xor : ret_map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (ret_map->base + get_bitmap_map_block_index(ret_map->length-1) != ret_map->end) {
+      printf("bitmap_xor : ret_map : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
+   }
+   if (ret_map->number_of_zeros + ret_map->number_of_ones != ret_map->length) {
+      printf("bitmap_xor : ret_map : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, ret_map);
    }
-   #endif
-   bit_indx = get_bitmap_map_block_bit_index(index);
-   
-   mask = 0x1 << ((MAP_BLOCK_BIT - 1) - bit_indx);
    
-   buf = (input_value & 0x1) << ((MAP_BLOCK_BIT - 1) - bit_indx);
-   buf &= mask;
+   if (enforce_same_size) {
+      if (map1->length != map2->length || map1->length != ret_map->length) {
+         printf("bitmap_xor : map1 and map2 have different sizes\n");
+         return map_blocks_check_fail(WRONG_INPUT, map1, map2, ret_map);
+      }
+   }
+   #endif
    
-   original = *(map->base + block_index) & mask;
+   // do XOR bitwise operation and count the result in the same pass
+   ones = map_blocks_logic_op(map1, map2, ret_map, S_B_OP_XOR);
    
-   *(map->base + block_index) &= ~mask;
-   *(map->base + block_index) |= buf;
+   ret_map->number_of_ones = ones;
+   ret_map->number_of_zeros = ret_map->length - ones;
    
-   if (buf == 0 && original != 0) {
-      map->number_of_zeros    ++;
-      map->number_of_ones     --;
-   }
-   else if (buf != 0 && original == 0) {
-      map->number_of_zeros    --;
-      map->number_of_ones     ++;
+   if (ret_map->summary != NULL) {
+      map_blocks_summary_rebuild(ret_map);
    }
+   s_b_rank_touch_all(ret_map);
+   
+   bitmap_meta_encrypt(map1);
+   bitmap_meta_encrypt(map2);
+   bitmap_meta_encrypt(ret_map);
    
-   if (!no_auto_crypt) {
-      bitmap_meta_encrypt(map);
-   }
-
    return 0;
 }
 
-int bitmap_count_zeros_and_ones (simple_bitmap* map) {
-   map_block mask;
-   
-   map_block buf;
-   
-   map_block* cur;
+// INTERNAL USE
+// number of one bits of src1 & src2 over map blocks 0 .. num-1
+static bit_index map_blocks_and_count (map_block* src1, map_block* src2, bit_index num) {
+   bit_index i;
    
-   unsigned char count;
-   
-   bitmap_meta_decrypt(map);
+   bit_index ones = 0;
    
-   // input check
-   #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_count_zeros_and_ones : map is NULL\n");
-      return WRONG_INPUT;
+   for (i = 0; i + S_B_WORD_BLOCKS <= num; i += S_B_WORD_BLOCKS) {
+      ones += s_b_popcount64(s_b_word_load(src1 + i) & s_b_word_load(src2 + i));
    }
-   if (map->base == NULL) {
-      printf("bitmap_count_zeros_and_ones : base is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map->end == NULL) {
-      printf("bitmap_count_zeros_and_ones : end is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map->length == 0) {
-      printf("bitmap_count_zeros_and_ones : map has no length\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_count_zeros_and_ones : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   for (; i < num; i++) {
+      ones += s_b_popcount(src1[i] & src2[i]);
    }
-   #endif
    
-   // setup mask so left most bit is 1
-   mask = 0x1 << (MAP_BLOCK_BIT - 1);
-   
-   // reset
-   map->number_of_zeros = 0;
-   map->number_of_ones = 0;
-   
-   // count all bits before last map_block
-   for (cur = map->base; cur < map->end; cur++) {
-      buf = *cur;
-      for (count = 0; count < MAP_BLOCK_BIT; count++) {
-         if ((buf & mask) == 0) {
-            map->number_of_zeros++;
+   return ones;
+}
+
+// INTERNAL USE
+// whether src1 op src2 has any one bit over map blocks 0 .. num-1, stops at the first word that has one
+// op is S_B_OP_AND, or S_B_OP_ANDNOT for src1 & ~src2
+static unsigned char map_blocks_logic_any (unsigned char op, map_block* src1, map_block* src2, bit_index num) {
+   bit_index i;
+   
+   if (op == S_B_OP_AND) {
+      for (i = 0; i + S_B_WORD_BLOCKS <= num; i += S_B_WORD_BLOCKS) {
+         if (s_b_word_load(src1 + i) & s_b_word_load(src2 + i)) {
+            return 1;
          }
-         else {
-            map->number_of_ones++;
+      }
+      for (; i < num; i++) {
+         if (src1[i] & src2[i]) {
+            return 1;
          }
-         buf = buf << 1;
       }
    }
-   
-   // setting once more to be sure
-   cur = map->end;
-   buf = *cur;
-   
-   // setup mask so left most bit is 1
-   mask = 0x1 << (MAP_BLOCK_BIT - 1);
-   
-   // count bits in last map_block
-   for (count = 0; count <= get_bitmap_map_block_bit_index(map->length-1); count++) {
-      if ((buf & mask) == 0) {
-         map->number_of_zeros++;
+   else {
+      for (i = 0; i + S_B_WORD_BLOCKS <= num; i += S_B_WORD_BLOCKS) {
+         if (s_b_word_load(src1 + i) & ~s_b_word_load(src2 + i)) {
+            return 1;
+         }
       }
-      else {
-         map->number_of_ones++;
+      for (; i < num; i++) {
+         if (src1[i] & ~src2[i]) {
+            return 1;
+         }
       }
-      buf = buf << 1;
    }
    
-   // clean up the edge
-   mask = 0;
-   for (count = 0; count <= get_bitmap_map_block_bit_index(map->length-1); count++) {
-      mask |= 0x1 << (MAP_BLOCK_BIT - count - 1);
-   }
-   *cur &= mask;
-   
-   bitmap_meta_encrypt(map);
-   
    return 0;
 }
 
-int bitmap_first_one_bit_index (simple_bitmap* map, bit_index* result, bit_index skip_to_bit) {
-   map_block buf;
+// INTERNAL USE, both maps must be decrypted
+// number of one bits of map1 & map2, bits past the end of the shorter map are treated as 0
+static bit_index map_blocks_logic_and_count (simple_bitmap* map1, simple_bitmap* map2) {
+   bit_index num1 = map1->end - map1->base + 1;
+   bit_index num2 = map2->end - map2->base + 1;
    
-   map_block mask;
-   
-   map_block* cur;
-   
-   uint_fast8_t count = 0;
+   if (map1->number_of_ones == 0 || map2->number_of_ones == 0) {
+      return 0;
+   }
    
-   bitmap_meta_decrypt(map);
+   return map_blocks_and_count(map1->base, map2->base, s_b_min(num1, num2));
+}
+
+int bitmap_and_count (simple_bitmap* map1, simple_bitmap* map2, bit_index* result) {
+   bitmap_meta_decrypt(map1);
+   bitmap_meta_decrypt(map2);
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_first_one_bit_index : map is NULL\n");
-      return WRONG_INPUT;
+   if (map1 == NULL) {
+      printf("bitmap_and_count : map1 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   if (map->base == NULL) {
-      printf("bitmap_first_one_bit_index : base is NULL\n");
-      return WRONG_INPUT;
+   if (map1->base == NULL) {
+      printf("bitmap_and_count : map1->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->end == NULL) {
-      printf("bitmap_first_one_bit_index : end is NULL\n");
-      return WRONG_INPUT;
+   if (map1->end == NULL) {
+      printf("bitmap_and_count : map1->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->length == 0) {
-      printf("bitmap_first_one_bit_index : map has no length\n");
-      return CORRUPTED_DATA;
+   if (map1->length == 0) {
+      printf("bitmap_and_count : map1 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_first_one_bit_index : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
+      printf("bitmap_and_count : map1 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_first_one_bit_index : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
+      printf("bitmap_and_count : map1 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (result == NULL) {
-      printf("bitmap_first_one_bit_index : result is null\n");
-      return WRONG_INPUT;
+   if (map2 == NULL) {
+      printf("bitmap_and_count : map2 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   if (skip_to_bit >= map->length) {
-      printf("bitmap_first_one_bit_index : skip_to_bit is out of range\n");
-      return WRONG_INPUT;
+   if (map2->base == NULL) {
+      printf("bitmap_and_count : map2->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   #endif
-   
-   // skip
-   cur = map->base + get_bitmap_map_block_index(skip_to_bit);
-   
-   buf = *cur;
-   
-   // mask skipped bits
-   mask = 0;
-   for (count = 0; count < MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(skip_to_bit); count++) {
-      mask |= 0x1 << count;
+   if (map2->end == NULL) {
+      printf("bitmap_and_count : map2->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   buf = buf & mask;
-   
-   // setup mask so left most bit is 1
-   mask = 0x1 << (MAP_BLOCK_BIT - 1);
-   
-   // find first non zero map_block
-   for (; cur <= map->end; cur++) {
-      if (count == 0) {
-         buf = *cur;
-      }
-      if (buf != 0) {
-         break;
-      }
-      count = 0;
+   if (map2->length == 0) {
+      printf("bitmap_and_count : map2 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   
-   // find first one bit
-   for (count = 0; count < MAP_BLOCK_BIT; count++) {
-      if (buf & mask) {
-         break;
-      }
-      buf = buf << 1;
+   if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
+      printf("bitmap_and_count : map2 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   
-   *result = (cur - map->base) * MAP_BLOCK_BIT + count;
-   
-   if (*result >= map->length) {
-      return SEARCH_FAIL;
+   if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
+      printf("bitmap_and_count : map2 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
+   if (result == NULL) {
+      printf("bitmap_and_count : result is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
+   }
+   #endif
    
-   bitmap_meta_encrypt(map);
+   // the padding bits are 0, so whole map blocks can be counted
+   *result = map_blocks_logic_and_count(map1, map2);
+   
+   bitmap_meta_encrypt(map1);
+   bitmap_meta_encrypt(map2);
    
    return 0;
 }
 
-int bitmap_first_zero_bit_index (simple_bitmap* map, bit_index* result, bit_index skip_to_bit) {
-   map_block buf;
-   
-   map_block mask;
-   
-   map_block* cur;
-   
-   uint_fast8_t count = 0;
-   
-   bitmap_meta_decrypt(map);
+int bitmap_or_count (simple_bitmap* map1, simple_bitmap* map2, bit_index* result) {
+   bitmap_meta_decrypt(map1);
+   bitmap_meta_decrypt(map2);
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_first_zero_bit_index : map is NULL\n");
-      return WRONG_INPUT;
+   if (map1 == NULL) {
+      printf("bitmap_or_count : map1 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   if (map->base == NULL) {
-      printf("bitmap_first_zero_bit_index : base is NULL\n");
-      return WRONG_INPUT;
+   if (map1->base == NULL) {
+      printf("bitmap_or_count : map1->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->end == NULL) {
-      printf("bitmap_first_zero_bit_index : end is NULL\n");
-      return WRONG_INPUT;
+   if (map1->end == NULL) {
+      printf("bitmap_or_count : map1->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->length == 0) {
-      printf("bitmap_first_zero_bit_index : map has no length\n");
-      return CORRUPTED_DATA;
+   if (map1->length == 0) {
+      printf("bitmap_or_count : map1 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_first_zero_bit_index : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
+      printf("bitmap_or_count : map1 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_first_zero_bit_index : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
+      printf("bitmap_or_count : map1 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (skip_to_bit >= map->length) {
-      printf("bitmap_first_zero_bit_index : skip_to_bit is out of range\n");
-      return WRONG_INPUT;
+   if (map2 == NULL) {
+      printf("bitmap_or_count : map2 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   #endif
-   
-   // skip
-   cur = map->base + get_bitmap_map_block_index(skip_to_bit);
-   
-   buf = *cur;
-   
-   // mask skipped bits
-   mask = 0;
-   for (count = 0; count < get_bitmap_map_block_bit_index(skip_to_bit); count++) {
-      mask |= 0x1 << (MAP_BLOCK_BIT - count - 1);
+   if (map2->base == NULL) {
+      printf("bitmap_or_count : map2->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   buf = buf | mask;
-   
-   // setup mask so left most bit is 1
-   mask = 0x1 << (MAP_BLOCK_BIT - 1);
-   
-   // find first non all one map_block
-   for (; cur <= map->end; cur++) {
-      if (count == 0) {
-         buf = *cur;
-      }
-      if (buf != (map_block) -1) {
-         break;
-      }
-      count = 0;
+   if (map2->end == NULL) {
+      printf("bitmap_or_count : map2->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   
-   // find first zero bit
-   for (count = 0; count < MAP_BLOCK_BIT; count++) {
-      if ((~buf) & mask) {
-         break;
-      }
-      buf = buf << 1;
+   if (map2->length == 0) {
+      printf("bitmap_or_count : map2 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   
-   *result = (cur - map->base) * MAP_BLOCK_BIT + count;
-   
-   if (*result >= map->length) {
-      return SEARCH_FAIL;
+   if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
+      printf("bitmap_or_count : map2 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
+      printf("bitmap_or_count : map2 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (result == NULL) {
+      printf("bitmap_or_count : result is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
+   #endif
    
-   bitmap_meta_encrypt(map);
+   // |a | b| = |a| + |b| - |a & b|
+   *result = map1->number_of_ones + map2->number_of_ones - map_blocks_logic_and_count(map1, map2);
+   
+   bitmap_meta_encrypt(map1);
+   bitmap_meta_encrypt(map2);
    
    return 0;
 }
 
-int bitmap_first_one_cont_group (simple_bitmap* map, bitmap_cont_group* ret_grp, bit_index skip_to_bit) {
-   map_block buf;
-  
-   map_block mask;
-   
-   map_block* cur;
-   
-   uint_fast8_t count = 0;
-  
-   bit_index zero_count;
-   bit_index one_count;
-   
-   bitmap_meta_decrypt(map);
+int bitmap_xor_count (simple_bitmap* map1, simple_bitmap* map2, bit_index* result) {
+   bitmap_meta_decrypt(map1);
+   bitmap_meta_decrypt(map2);
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_first_one_cont_group : map is NULL\n");
-      return WRONG_INPUT;
+   if (map1 == NULL) {
+      printf("bitmap_xor_count : map1 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   if (map->base == NULL) {
-      printf("bitmap_first_one_cont_group : base is NULL\n");
-      return WRONG_INPUT;
+   if (map1->base == NULL) {
+      printf("bitmap_xor_count : map1->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->end == NULL) {
-      printf("bitmap_first_one_cont_group : end is NULL\n");
-      return WRONG_INPUT;
+   if (map1->end == NULL) {
+      printf("bitmap_xor_count : map1->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->length == 0) {
-      printf("bitmap_first_one_cont_group : map has no length\n");
-      return CORRUPTED_DATA;
+   if (map1->length == 0) {
+      printf("bitmap_xor_count : map1 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_first_one_cont_group : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
+      printf("bitmap_xor_count : map1 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_first_one_cont_group : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
+      printf("bitmap_xor_count : map1 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (ret_grp == NULL) {
-      printf("bitmap_first_one_cont_group : ret_grp is NULL\n");
-      return WRONG_INPUT;
+   if (map2 == NULL) {
+      printf("bitmap_xor_count : map2 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   if (skip_to_bit >= map->length) {
-      printf("bitmap_first_one_cont_group : skip_to_bit is out of range\n");
-      return WRONG_INPUT;
+   if (map2->base == NULL) {
+      printf("bitmap_xor_count : map2->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   #endif
-   
-   // setup return group
-   ret_grp->bit_type = 0x1;
-   ret_grp->start = 0;
-   ret_grp->length = 0;
-   
-   // skip
-   cur = map->base + get_bitmap_map_block_index(skip_to_bit);
-   
-   buf = *cur;
-   
-   // mask skipped bits
-   mask = 0;
-   for (count = 0; count < MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(skip_to_bit); count++) {
-      mask |= 0x1 << count;
+   if (map2->end == NULL) {
+      printf("bitmap_xor_count : map2->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   buf = buf & mask;
-   
-   // setup mask so left most bit is 1
-   mask = 0x1 << (MAP_BLOCK_BIT - 1);
-   
-   // find first non zero map block
-   for (; cur <= map->end; cur++) {
-      if (count == 0) {
-         buf = *cur;
-      }
-      if (buf != 0) {
-         break;
-      }
-      count = 0;
+   if (map2->length == 0) {
+      printf("bitmap_xor_count : map2 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   
-   // find first one bit
-   for (zero_count = 0; zero_count < MAP_BLOCK_BIT; zero_count++) {
-      if (buf & mask) {
-         break;
-      }
-      buf = buf << 1;
+   if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
+      printf("bitmap_xor_count : map2 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   
-   // set start
-   ret_grp->start = (cur - map->base) * MAP_BLOCK_BIT + zero_count;
-   
-   if (ret_grp->start >= map->length) {
-      return SEARCH_FAIL;
+   if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
+      printf("bitmap_xor_count : map2 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   
-   // cur initialised already
-   for (; cur <= map->end; cur++) {
-      if (zero_count == 0) {
-         buf = *cur;
-      }
-      
-      // count ones
-      for (one_count = 0; one_count < MAP_BLOCK_BIT - zero_count; one_count++) {
-         if ((~buf) & mask) {
-            break;
-         }
-         buf = buf << 1;
-      }
-      
-      // update count
-      ret_grp->length += one_count;
-      
-      if ((one_count + zero_count) != MAP_BLOCK_BIT) {
-         // the one bits end in this map_block, no need to continue
-         break;
-      }
-      
-      zero_count = 0;
+   if (result == NULL) {
+      printf("bitmap_xor_count : result is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
+   #endif
    
-   bitmap_meta_encrypt(map);
+   // |a ^ b| = |a| + |b| - 2|a & b|
+   *result = map1->number_of_ones + map2->number_of_ones - 2 * map_blocks_logic_and_count(map1, map2);
+   
+   bitmap_meta_encrypt(map1);
+   bitmap_meta_encrypt(map2);
    
    return 0;
 }
 
-int bitmap_first_zero_cont_group (simple_bitmap* map, bitmap_cont_group* ret_grp, bit_index skip_to_bit) {
-   map_block buf;
-  
-   map_block mask;
-  
-   map_block* cur;
-  
-   uint_fast8_t count = 0;
-  
-   bit_index zero_count;
-   bit_index one_count;
-   
-   bitmap_meta_decrypt(map);
+int bitmap_equal (simple_bitmap* map1, simple_bitmap* map2, unsigned char* result) {
+   bitmap_meta_decrypt(map1);
+   bitmap_meta_decrypt(map2);
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_first_zero_cont_group : map is NULL\n");
-      return WRONG_INPUT;
+   if (map1 == NULL) {
+      printf("bitmap_equal : map1 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   if (map->base == NULL) {
-      printf("bitmap_first_zero_cont_group : base is NULL\n");
-      return WRONG_INPUT;
+   if (map1->base == NULL) {
+      printf("bitmap_equal : map1->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->end == NULL) {
-      printf("bitmap_first_zero_cont_group : end is NULL\n");
-      return WRONG_INPUT;
+   if (map1->end == NULL) {
+      printf("bitmap_equal : map1->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->length == 0) {
-      printf("bitmap_first_zero_cont_group : map has no length\n");
-      return CORRUPTED_DATA;
+   if (map1->length == 0) {
+      printf("bitmap_equal : map1 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_first_zero_cont_group : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
+      printf("bitmap_equal : map1 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_first_zero_cont_group : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
+      printf("bitmap_equal : map1 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (ret_grp == NULL) {
-      printf("bitmap_first_zero_cont_group : ret_grp is NULL\n");
-      return WRONG_INPUT;
+   if (map2 == NULL) {
+      printf("bitmap_equal : map2 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   if (skip_to_bit >= map->length) {
-      printf("bitmap_first_zero_cont_group : skip_to_bit is out of range\n");
-      return WRONG_INPUT;
+   if (map2->base == NULL) {
+      printf("bitmap_equal : map2->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   #endif
-   
-   // setup return group
-   ret_grp->bit_type = 0x0;
-   ret_grp->start = 0;
-   ret_grp->length = 0;
-   
-   // skip
-   cur = map->base + get_bitmap_map_block_index(skip_to_bit);
-   
-   buf = *cur;
-   
-   // mask skipped bits
-   mask = 0;
-   for (count = 0; count < get_bitmap_map_block_bit_index(skip_to_bit); count++) {
-      mask |= 0x1 << (MAP_BLOCK_BIT - count - 1);
+   if (map2->end == NULL) {
+      printf("bitmap_equal : map2->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   buf = buf | mask;
-   
-   // setup mask so left most bit is 1
-   mask = 0x1 << (MAP_BLOCK_BIT - 1);
-   
-   // find first non all one map block
-   for (; cur <= map->end; cur++) {
-      if (count == 0) {
-         buf = *cur;
-      }
-      if (buf != (map_block) -1) {
-         break;
-      }
-      count = 0;
+   if (map2->length == 0) {
+      printf("bitmap_equal : map2 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   
-   // find first zero bit
-   for (one_count = 0; one_count < MAP_BLOCK_BIT; one_count++) {
-      if ((~buf) & mask) {
-         break;
-      }
-      buf = buf << 1;
+   if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
+      printf("bitmap_equal : map2 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-
-   // set start
-   ret_grp->start = (cur - map->base) * MAP_BLOCK_BIT + one_count;
-   
-   if (ret_grp->start >= map->length) {
-      return SEARCH_FAIL;
+   if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
+      printf("bitmap_equal : map2 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (result == NULL) {
+      printf("bitmap_equal : result is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
+   #endif
    
-   // cur initialised already
-   for (; cur <= map->end; cur++) {
-      if (one_count == 0) {
-         buf = *cur;
-      }
-      
-      // count zeros
-      for (zero_count = 0; zero_count < MAP_BLOCK_BIT - one_count; zero_count++) {
-         if (buf & mask) {
-            break;
-         }
-         buf = buf << 1;
-      }
-      
-      // update count
-      ret_grp->length += zero_count;
-      
-      if ((zero_count + one_count) != MAP_BLOCK_BIT) {
-         // the zero bits end in this map_block, no need to continue
-         break;
-      }
-      
-      one_count = 0;
+   // the padding bits are 0, so whole map blocks can be compared,
+   // memcmp stops at the first difference
+   if (map1->length != map2->length || map1->number_of_ones != map2->number_of_ones) {
+      *result = 0;
+   }
+   else {
+      *result = memcmp(map1->base, map2->base, sizeof(map_block) * (map1->end - map1->base + 1)) == 0;
    }
    
-   bitmap_meta_encrypt(map);
+   bitmap_meta_encrypt(map1);
+   bitmap_meta_encrypt(map2);
    
    return 0;
 }
 
-int bitmap_first_one_bit_index_back (simple_bitmap* map, bit_index* result, bit_index skip_to_bit) {
-   map_block buf;
-   
-   map_block mask;
-   
-   map_block* cur;
-   
-   uint_fast8_t count = 0;
+int bitmap_is_subset (simple_bitmap* map1, simple_bitmap* map2, unsigned char* result) {
+   bit_index num1;
+   bit_index num2;
+   bit_index common;
    
-   bitmap_meta_decrypt(map);
+   bitmap_meta_decrypt(map1);
+   bitmap_meta_decrypt(map2);
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_first_one_bit_index_back : map is NULL\n");
-      return WRONG_INPUT;
+   if (map1 == NULL) {
+      printf("bitmap_is_subset : map1 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   if (map->base == NULL) {
-      printf("bitmap_first_one_bit_index_back : base is NULL\n");
-      return WRONG_INPUT;
+   if (map1->base == NULL) {
+      printf("bitmap_is_subset : map1->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->end == NULL) {
-      printf("bitmap_first_one_bit_index_back : end is NULL\n");
-      return WRONG_INPUT;
+   if (map1->end == NULL) {
+      printf("bitmap_is_subset : map1->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->length == 0) {
-      printf("bitmap_first_one_bit_index_back : map has no length\n");
-      return CORRUPTED_DATA;
+   if (map1->length == 0) {
+      printf("bitmap_is_subset : map1 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_first_one_bit_index_back : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
+      printf("bitmap_is_subset : map1 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_first_one_bit_index_back : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
+      printf("bitmap_is_subset : map1 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (result == NULL) {
-      printf("bitmap_first_one_bit_index_back : result is null\n");
-      return WRONG_INPUT;
+   if (map2 == NULL) {
+      printf("bitmap_is_subset : map2 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   if (skip_to_bit >= map->length) {
-      printf("bitmap_first_one_bit_index_back : skip_to_bit is out of range\n");
-      return WRONG_INPUT;
+   if (map2->base == NULL) {
+      printf("bitmap_is_subset : map2->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   #endif
-   
-   // skip
-   cur = map->base + get_bitmap_map_block_index(skip_to_bit);
-   
-   buf = *cur;
-   
-   // mask skipped bits
-   mask = 0;
-   for (count = 0; count <= get_bitmap_map_block_bit_index(skip_to_bit); count++) {
-      mask |= (0x1 << (MAP_BLOCK_BIT - 1)) >> count;
+   if (map2->end == NULL) {
+      printf("bitmap_is_subset : map2->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (map2->length == 0) {
+      printf("bitmap_is_subset : map2 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
+      printf("bitmap_is_subset : map2 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
+      printf("bitmap_is_subset : map2 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (result == NULL) {
+      printf("bitmap_is_subset : result is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   buf = buf & mask;
+   #endif
    
-   // setup mask so right most bit is 1
-   mask = 0x1;
+   num1 = map1->end - map1->base + 1;
+   num2 = map2->end - map2->base + 1;
+   common = s_b_min(num1, num2);
    
-   // find first non zero map_block
-   for (; cur >= map->base; cur--) {
-      if (count == MAP_BLOCK_BIT) {
-         buf = *cur;
-      }
-      if (buf != 0) {
-         break;
-      }
-      count = MAP_BLOCK_BIT;
+   if (map1->number_of_ones == 0) {
+      *result = 1;
    }
-   
-   // find first one bit
-   for (count = 0; count < MAP_BLOCK_BIT; count++) {
-      if (buf & mask) {
-         break;
-      }
-      buf = buf >> 1;
+   else if (map1->number_of_ones > map2->number_of_ones) {
+      *result = 0;
    }
-   
-   if (count == MAP_BLOCK_BIT) { // failed to find the one bit
-      *result = map->length;
-      return SEARCH_FAIL;
+   else if (map_blocks_logic_any(S_B_OP_ANDNOT, map1->base, map2->base, common)) {
+      *result = 0;
    }
    else {
-      *result = (cur - map->base) * MAP_BLOCK_BIT + (MAP_BLOCK_BIT-1 - count);
-      return 0;
+      // ones of map1 past the end of map2
+      *result = num1 <= common || map_blocks_scan_fwd(map1->base + common, num1 - common, 0) == (num1 - common) * MAP_BLOCK_BIT;
    }
    
-   bitmap_meta_encrypt(map);
+   bitmap_meta_encrypt(map1);
+   bitmap_meta_encrypt(map2);
    
    return 0;
 }
 
-int bitmap_first_zero_bit_index_back (simple_bitmap* map, bit_index* result, bit_index skip_to_bit) {
-   map_block buf;
-   
-   map_block mask;
-   
-   map_block* cur;
+int bitmap_intersects (simple_bitmap* map1, simple_bitmap* map2, unsigned char* result) {
+   bit_index num1;
+   bit_index num2;
    
-   uint_fast8_t count = 0;
-   
-   bitmap_meta_decrypt(map);
+   bitmap_meta_decrypt(map1);
+   bitmap_meta_decrypt(map2);
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_first_zero_bit_index_back : map is NULL\n");
-      return WRONG_INPUT;
+   if (map1 == NULL) {
+      printf("bitmap_intersects : map1 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
-   if (map->base == NULL) {
-      printf("bitmap_first_zero_bit_index_back : base is NULL\n");
-      return WRONG_INPUT;
+   if (map1->base == NULL) {
+      printf("bitmap_intersects : map1->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->end == NULL) {
-      printf("bitmap_first_zero_bit_index_back : end is NULL\n");
-      return WRONG_INPUT;
+   if (map1->end == NULL) {
+      printf("bitmap_intersects : map1->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->length == 0) {
-      printf("bitmap_first_zero_bit_index_back : map has no length\n");
-      return CORRUPTED_DATA;
+   if (map1->length == 0) {
+      printf("bitmap_intersects : map1 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_first_zero_bit_index_back : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (map1->base + get_bitmap_map_block_index(map1->length-1) != map1->end) {
+      printf("bitmap_intersects : map1 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_first_zero_bit_index_back : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (map1->number_of_zeros + map1->number_of_ones != map1->length) {
+      printf("bitmap_intersects : map1 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
    }
-   if (skip_to_bit >= map->length) {
-      printf("bitmap_first_zero_bit_index_back : skip_to_bit is out of range\n");
-      return WRONG_INPUT;
+   if (map2 == NULL) {
+      printf("bitmap_intersects : map2 is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
+   }
+   if (map2->base == NULL) {
+      printf("bitmap_intersects : map2->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (map2->end == NULL) {
+      printf("bitmap_intersects : map2->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (map2->length == 0) {
+      printf("bitmap_intersects : map2 has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (map2->base + get_bitmap_map_block_index(map2->length-1) != map2->end) {
+      printf("bitmap_intersects : map2 : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (map2->number_of_zeros + map2->number_of_ones != map2->length) {
+      printf("bitmap_intersects : map2 : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map1, map2, NULL);
+   }
+   if (result == NULL) {
+      printf("bitmap_intersects : result is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map1, map2, NULL);
    }
    #endif
    
-   // skip
-   cur = map->base + get_bitmap_map_block_index(skip_to_bit);
+   num1 = map1->end - map1->base + 1;
+   num2 = map2->end - map2->base + 1;
    
-   buf = *cur;
-   
-   // mask skipped bits
-   mask = 0;
-   for (count = 0; count < MAP_BLOCK_BIT-1 - get_bitmap_map_block_bit_index(skip_to_bit); count++) {
-      mask |= 0x1 << count;
+   if (map1->number_of_ones == 0 || map2->number_of_ones == 0) {
+      *result = 0;
+   }
+   else if (map1->length == map2->length && map1->number_of_ones + map2->number_of_ones > map1->length) {
+      // too many ones to all be apart
+      *result = 1;
+   }
+   else {
+      *result = map_blocks_logic_any(S_B_OP_AND, map1->base, map2->base, s_b_min(num1, num2));
    }
-   buf = buf | mask;
    
-   // setup mask so right most bit is 1
-   mask = 0x1;
+   bitmap_meta_encrypt(map1);
+   bitmap_meta_encrypt(map2);
    
-   // find first non all one map_block
-   for (; cur >= map->base; cur--) {
-      if (count == MAP_BLOCK_BIT) {
-         buf = *cur;
-      }
-      if (buf != (map_block) -1) {
-         break;
+   return 0;
+}
+
+// size of the chunks bitmap_expr_eval works through, in map blocks
+#define S_B_EXPR_CHUNK_BLOCKS (1024 / sizeof(map_block))
+
+// INTERNAL USE, prog must be checked
+// evaluates prog over map blocks from .. from+num-1 of the maps, num is at most S_B_EXPR_CHUNK_BLOCKS,
+// returns the result, either in buf or the map blocks of one of the maps
+static map_block* map_blocks_expr_chunk (const bitmap_expr_op* prog, bit_index prog_len, simple_bitmap** maps,
+                                         bit_index from, bit_index num, map_block buf[][S_B_EXPR_CHUNK_BLOCKS]) {
+   // operands on the stack point either into the maps or into buf,
+   // an operation writes its result to the buf entry of its lowest operand
+   map_block* slot[BITMAP_EXPR_MAX_DEPTH];
+   
+   map_block* x;
+   map_block* y;
+   map_block* m;
+   map_block* out;
+   
+   bit_index pc;
+   bit_index i;
+   
+   unsigned char sp = 0;
+   
+   // plain loops over whole blocks, one per operation, so the compiler can vectorise them
+   for (pc = 0; pc < prog_len; pc++) {
+      switch (prog[pc].code) {
+         case BITMAP_EXPR_PUSH :
+            slot[sp++] = maps[prog[pc].operand]->base + from;
+            break;
+         case BITMAP_EXPR_NOT :
+            x = slot[sp-1];
+            out = buf[sp-1];
+            for (i = 0; i < num; i++) {
+               out[i] = ~x[i];
+            }
+            slot[sp-1] = out;
+            break;
+         case BITMAP_EXPR_AND :
+            x = slot[sp-2];
+            y = slot[sp-1];
+            out = buf[sp-2];
+            for (i = 0; i < num; i++) {
+               out[i] = x[i] & y[i];
+            }
+            slot[sp-2] = out;
+            sp--;
+            break;
+         case BITMAP_EXPR_OR :
+            x = slot[sp-2];
+            y = slot[sp-1];
+            out = buf[sp-2];
+            for (i = 0; i < num; i++) {
+               out[i] = x[i] | y[i];
+            }
+            slot[sp-2] = out;
+            sp--;
+            break;
+         case BITMAP_EXPR_XOR :
+            x = slot[sp-2];
+            y = slot[sp-1];
+            out = buf[sp-2];
+            for (i = 0; i < num; i++) {
+               out[i] = x[i] ^ y[i];
+            }
+            slot[sp-2] = out;
+            sp--;
+            break;
+         case BITMAP_EXPR_ANDNOT :
+            x = slot[sp-2];
+            y = slot[sp-1];
+            out = buf[sp-2];
+            for (i = 0; i < num; i++) {
+               out[i] = x[i] & ~y[i];
+            }
+            slot[sp-2] = out;
+            sp--;
+            break;
+         case BITMAP_EXPR_BLEND :
+            x = slot[sp-3];
+            y = slot[sp-2];
+            m = slot[sp-1];
+            out = buf[sp-3];
+            for (i = 0; i < num; i++) {
+               out[i] = (x[i] & m[i]) | (y[i] & ~m[i]);
+            }
+            slot[sp-3] = out;
+            sp -= 2;
+            break;
       }
-      count = MAP_BLOCK_BIT;
    }
    
-   // find first zero bit
-   for (count = 0; count < MAP_BLOCK_BIT; count++) {
-      if ((~buf) & mask) {
-         break;
+   return slot[0];
+}
+
+#ifndef SIMPLE_BITMAP_SKIP_CHECK
+// INTERNAL USE
+// map_blocks_check_fail for the maps of bitmap_expr_eval
+static int map_blocks_expr_check_fail (int ret, simple_bitmap** maps, bit_index map_num, simple_bitmap* ret_map) {
+   bit_index i;
+   
+   if (maps != NULL) {
+      for (i = 0; i < map_num; i++) {
+         map_blocks_check_fail(ret, maps[i], NULL, NULL);
       }
-      buf = buf >> 1;
-   }
-   
-   if (count == MAP_BLOCK_BIT) {
-      *result = map->length;
-      return SEARCH_FAIL;
    }
-   else {
-      *result = (cur - map->base) * MAP_BLOCK_BIT + (MAP_BLOCK_BIT-1 - count);
-      return 0;
-   }
-   
-   bitmap_meta_encrypt(map);
    
-   return 0;
+   return map_blocks_check_fail(ret, ret_map, NULL, NULL);
 }
+#endif
 
-int bitmap_first_one_cont_group_back (simple_bitmap* map, bitmap_cont_group* ret_grp, bit_index skip_to_bit) {
-   map_block buf;
-  
-   map_block mask;
-   
-   map_block* cur;
+int bitmap_expr_eval (const bitmap_expr_op* prog, bit_index prog_len, simple_bitmap** maps, bit_index map_num,
+                      simple_bitmap* ret_map, bit_index* ones) {
+   map_block buf[BITMAP_EXPR_MAX_DEPTH][S_B_EXPR_CHUNK_BLOCKS];
    
-   uint_fast8_t count = 0;
-  
-   bit_index zero_count;
-   bit_index one_count;
+   map_block* res;
    
-   bit_index end;
+   map_block tail_mask;
    
-   bitmap_meta_decrypt(map);
+   bit_index num;
+   bit_index from;
+   bit_index chunk;
+   bit_index count;
+   bit_index i;
    
-   // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (map == NULL) {
-      printf("bitmap_first_one_cont_group_back : map is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map->base == NULL) {
-      printf("bitmap_first_one_cont_group_back : base is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map->end == NULL) {
-      printf("bitmap_first_one_cont_group_back : end is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map->length == 0) {
-      printf("bitmap_first_one_cont_group_back : map has no length\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_first_one_cont_group_back : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_first_one_cont_group_back : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
-   }
-   if (ret_grp == NULL) {
-      printf("bitmap_first_one_cont_group_back : ret_grp is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (skip_to_bit >= map->length) {
-      printf("bitmap_first_one_cont_group_back : skip_to_bit is out of range\n");
-      return WRONG_INPUT;
-   }
+   bit_index depth;
    #endif
    
-   // setup return group
-   ret_grp->bit_type = 0x1;
-   ret_grp->start = 0;
-   ret_grp->length = 0;
-   
-   // skip
-   cur = map->base + get_bitmap_map_block_index(skip_to_bit);
-   
-   buf = *cur;
-   
-   // mask skipped bits
-   mask = 0;
-   for (count = 0; count <= get_bitmap_map_block_bit_index(skip_to_bit); count++) {
-      mask |= (0x1 << (MAP_BLOCK_BIT - 1)) >> count;
+   if (maps != NULL) {
+      for (i = 0; i < map_num; i++) {
+         bitmap_meta_decrypt(maps[i]);
+      }
+   }
+   if (ret_map != NULL) {
+      bitmap_meta_decrypt(ret_map);
    }
-   buf = buf & mask;
-   
-   // setup mask so right most bit is 1
-   mask = 0x1;
    
-   // find first non zero map block
-   for (; cur >= map->base; cur--) {
-      if (count == MAP_BLOCK_BIT) {
-         buf = *cur;
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (maps == NULL || map_num == 0) {
+      printf("bitmap_expr_eval : no maps given\n");
+      return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
+   }
+   for (i = 0; i < map_num; i++) {
+      if (maps[i] == NULL) {
+         printf("bitmap_expr_eval : maps[%lu] is NULL\n", (unsigned long) i);
+         return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
       }
-      if (buf != 0) {
-         break;
+      if (maps[i]->base == NULL) {
+         printf("bitmap_expr_eval : maps[%lu]->base is NULL\n", (unsigned long) i);
+         return map_blocks_expr_check_fail(CORRUPTED_DATA, maps, map_num, ret_map);
+      }
+      if (maps[i]->end == NULL) {
+         printf("bitmap_expr_eval : maps[%lu]->end is NULL\n", (unsigned long) i);
+         return map_blocks_expr_check_fail(CORRUPTED_DATA, maps, map_num, ret_map);
+      }
+      if (maps[i]->length == 0) {
+         printf("bitmap_expr_eval : maps[%lu] has no length\n", (unsigned long) i);
+         return map_blocks_expr_check_fail(CORRUPTED_DATA, maps, map_num, ret_map);
+      }
+      if (maps[i]->base + get_bitmap_map_block_index(maps[i]->length-1) != maps[i]->end) {
+         printf("bitmap_expr_eval : maps[%lu] : length is inconsistent with base and end\n", (unsigned long) i);
+         return map_blocks_expr_check_fail(CORRUPTED_DATA, maps, map_num, ret_map);
+      }
+      if (maps[i]->length != maps[0]->length) {
+         printf("bitmap_expr_eval : maps have different sizes\n");
+         return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
       }
-      count = MAP_BLOCK_BIT;
    }
-   
-   // find first one bit
-   for (zero_count = 0; zero_count < MAP_BLOCK_BIT; zero_count++) {
-      if (buf & mask) {
-         break;
+   if (ret_map != NULL) {
+      if (ret_map->base == NULL) {
+         printf("bitmap_expr_eval : ret_map->base is NULL\n");
+         return map_blocks_expr_check_fail(CORRUPTED_DATA, maps, map_num, ret_map);
+      }
+      if (ret_map->end == NULL) {
+         printf("bitmap_expr_eval : ret_map->end is NULL\n");
+         return map_blocks_expr_check_fail(CORRUPTED_DATA, maps, map_num, ret_map);
+      }
+      if (ret_map->length != maps[0]->length) {
+         printf("bitmap_expr_eval : ret_map and maps have different sizes\n");
+         return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
+      }
+      if (ret_map->base + get_bitmap_map_block_index(ret_map->length-1) != ret_map->end) {
+         printf("bitmap_expr_eval : ret_map : length is inconsistent with base and end\n");
+         return map_blocks_expr_check_fail(CORRUPTED_DATA, maps, map_num, ret_map);
       }
-      buf = buf >> 1;
    }
-   
-   if (zero_count == MAP_BLOCK_BIT) {
-      return SEARCH_FAIL;
+   if (prog == NULL || prog_len == 0) {
+      printf("bitmap_expr_eval : prog is empty\n");
+      return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
+   }
+   // run the program on the depth of the stack only
+   for (i = 0, depth = 0; i < prog_len; i++) {
+      switch (prog[i].code) {
+         case BITMAP_EXPR_PUSH :
+            if (prog[i].operand >= map_num) {
+               printf("bitmap_expr_eval : prog[%lu] : operand exceeds number of maps\n", (unsigned long) i);
+               return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
+            }
+            if (depth == BITMAP_EXPR_MAX_DEPTH) {
+               printf("bitmap_expr_eval : prog[%lu] : stack is deeper than BITMAP_EXPR_MAX_DEPTH\n", (unsigned long) i);
+               return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
+            }
+            depth++;
+            break;
+         case BITMAP_EXPR_NOT :
+            if (depth < 1) {
+               printf("bitmap_expr_eval : prog[%lu] : too few operands\n", (unsigned long) i);
+               return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
+            }
+            break;
+         case BITMAP_EXPR_AND :
+         case BITMAP_EXPR_OR :
+         case BITMAP_EXPR_XOR :
+         case BITMAP_EXPR_ANDNOT :
+            if (depth < 2) {
+               printf("bitmap_expr_eval : prog[%lu] : too few operands\n", (unsigned long) i);
+               return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
+            }
+            depth--;
+            break;
+         case BITMAP_EXPR_BLEND :
+            if (depth < 3) {
+               printf("bitmap_expr_eval : prog[%lu] : too few operands\n", (unsigned long) i);
+               return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
+            }
+            depth -= 2;
+            break;
+         default :
+            printf("bitmap_expr_eval : prog[%lu] : unknown code\n", (unsigned long) i);
+            return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
+      }
    }
-   else {
-      end = (cur - map->base) * MAP_BLOCK_BIT + (MAP_BLOCK_BIT-1 - zero_count);
+   if (depth != 1) {
+      printf("bitmap_expr_eval : prog leaves %lu operands instead of 1\n", (unsigned long) depth);
+      return map_blocks_expr_check_fail(WRONG_INPUT, maps, map_num, ret_map);
    }
+   #endif
    
-   // cur initialised already
-   for (; cur >= map->base; cur--) {
-      if (zero_count == 0) {
-         buf = *cur;
-      }
+   num = maps[0]->end - maps[0]->base + 1;
+   tail_mask = s_b_head_mask(get_bitmap_map_block_bit_index(maps[0]->length-1) + 1);
+   
+   count = 0;
+   
+   for (from = 0; from < num; from += chunk) {
+      chunk = s_b_min(num - from, S_B_EXPR_CHUNK_BLOCKS);
       
-      // count ones
-      for (one_count = 0; one_count < MAP_BLOCK_BIT - zero_count; one_count++) {
-         if ((~buf) & mask) {
-            break;
-         }
-         buf = buf >> 1;
+      res = map_blocks_expr_chunk(prog, prog_len, maps, from, chunk, buf);
+      
+      if (ret_map != NULL && res != ret_map->base + from) {
+         memcpy(ret_map->base + from, res, sizeof(map_block) * chunk);
       }
       
-      // update count
-      ret_grp->length += one_count;
+      count += map_blocks_count_bits(res, 0, chunk * MAP_BLOCK_BIT);
       
-      if ((one_count + zero_count) != MAP_BLOCK_BIT) {
-         // the one bits end in this map_block, no need to continue
-         break;
+      // padding bits of the result, e.g. after NOT, are not part of it
+      if (from + chunk == num) {
+         count -= s_b_popcount(res[chunk-1] & ~tail_mask);
+         if (ret_map != NULL) {
+            ret_map->base[num-1] &= tail_mask;
+         }
       }
-      
-      zero_count = 0;
    }
    
-   // set start
-   ret_grp->start = end - ret_grp->length + 1;
+   if (ones != NULL) {
+      *ones = count;
+   }
    
-   bitmap_meta_encrypt(map);
+   if (ret_map != NULL) {
+      ret_map->number_of_ones = count;
+      ret_map->number_of_zeros = ret_map->length - count;
+      
+      if (ret_map->summary != NULL) {
+         map_blocks_summary_rebuild(ret_map);
+      }
+      s_b_rank_touch_all(ret_map);
+   }
+   
+   for (i = 0; i < map_num; i++) {
+      bitmap_meta_encrypt(maps[i]);
+   }
+   if (ret_map != NULL) {
+      bitmap_meta_encrypt(ret_map);
+   }
    
    return 0;
 }
 
-int bitmap_first_zero_cont_group_back (simple_bitmap* map, bitmap_cont_group* ret_grp, bit_index skip_to_bit) {
-   map_block buf;
-  
+int bitmap_read (simple_bitmap* map, bit_index index, map_block* result, unsigned char no_auto_crypt) {
+   //map_block* cur;
+   
+   uint_fast32_t block_index;
+   unsigned char bit_indx;
+   
    map_block mask;
-  
-   map_block* cur;
-  
-   uint_fast8_t count = 0;
-  
-   bit_index zero_count;
-   bit_index one_count;
    
-   bit_index end;
+   map_block buf;
    
-   bitmap_meta_decrypt(map);
+   if (!no_auto_crypt) {
+      bitmap_meta_decrypt(map);
+   }
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
    if (map == NULL) {
-      printf("bitmap_first_zero_cont_group_back : map is NULL\n");
-      return WRONG_INPUT;
+      printf("bitmap_read : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    if (map->base == NULL) {
-      printf("bitmap_first_zero_cont_group_back : base is NULL\n");
-      return WRONG_INPUT;
+      printf("bitmap_read : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    if (map->end == NULL) {
-      printf("bitmap_first_zero_cont_group_back : end is NULL\n");
-      return WRONG_INPUT;
+      printf("bitmap_read : end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    if (map->length == 0) {
-      printf("bitmap_first_zero_cont_group_back : map has no length\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_read : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_first_zero_cont_group_back : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_read : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_first_zero_cont_group_back : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
-   }
-   if (ret_grp == NULL) {
-      printf("bitmap_first_zero_cont_group_back : ret_grp is NULL\n");
-      return WRONG_INPUT;
+      printf("bitmap_read : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
    }
-   if (skip_to_bit >= map->length) {
-      printf("bitmap_first_zero_cont_group_back : skip_to_bit is out of range\n");
-      return WRONG_INPUT;
+   #endif
+   block_index = get_bitmap_map_block_index(index);
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map->base + block_index > map->end || index >= map->length) {
+      printf("bitmap_read : index exceeds range\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    #endif
+   bit_indx = get_bitmap_map_block_bit_index(index);
    
-   // setup return group
-   ret_grp->bit_type = 0x0;
-   ret_grp->start = 0;
-   ret_grp->length = 0;
-   
-   // skip
-   cur = map->base + get_bitmap_map_block_index(skip_to_bit);
+   mask = (map_block) 0x1 << ((MAP_BLOCK_BIT - 1) - bit_indx);
    
-   buf = *cur;
+   buf = *(map->base + block_index) & mask;
    
-   // mask skipped bits
-   mask = 0;
-   for (count = 0; count < MAP_BLOCK_BIT-1 - get_bitmap_map_block_bit_index(skip_to_bit); count++) {
-      mask |= 0x1 << count;
-   }
-   buf = buf | mask;
+   buf = buf >> ((MAP_BLOCK_BIT - 1) - bit_indx);
    
-   // setup mask so right most bit is 1
-   mask = 0x1;
+   *result = buf;
    
-   // find first non all one map block
-   for (; cur >= map->base; cur--) {
-      if (count == MAP_BLOCK_BIT) {
-         buf = *cur;
-      }
-      if (buf != (map_block) -1) {
-         break;
-      }
-      count = MAP_BLOCK_BIT;
+   if (!no_auto_crypt) {
+      bitmap_meta_encrypt(map);
    }
    
-   // find first zero bit
-   for (one_count = 0; one_count < MAP_BLOCK_BIT; one_count++) {
-      if ((~buf) & mask) {
-         break;
-      }
-      buf = buf >> 1;
-   }
+   return 0;
+}
+
+int bitmap_write (simple_bitmap* map, bit_index index, map_block input_value, unsigned char no_auto_crypt) {
+   //map_block* cur;
    
-   if (one_count == MAP_BLOCK_BIT) {
-      return SEARCH_FAIL;
+   uint_fast32_t block_index;
+   unsigned char bit_indx;
+   
+   map_block mask;
+   
+   map_block buf;
+   
+   map_block original;
+   
+   if (!no_auto_crypt) {
+      bitmap_meta_decrypt(map);
    }
-   else {
-      end = (cur - map->base) * MAP_BLOCK_BIT + (MAP_BLOCK_BIT-1 - one_count);
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_write : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
-   
-   // cur initialised already
-   for (; cur >= map->base; cur--) {
-      if (one_count == 0) {
-         buf = *cur;
-      }
-      
-      // count zeros
-      for (zero_count = 0; zero_count < MAP_BLOCK_BIT - one_count; zero_count++) {
-         if (buf & mask) {
-            break;
-         }
-         buf = buf >> 1;
-      }
-      
-      // update count
-      ret_grp->length += zero_count;
-      
-      if ((zero_count + one_count) != MAP_BLOCK_BIT) {
-         // the zero bits end in this map_block, no need to continue
-         break;
-      }
-      
-      one_count = 0;
+   if (map->base == NULL) {
+      printf("bitmap_write : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_write : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
+   if (map->length == 0) {
+      printf("bitmap_write : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_write : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_write : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   #endif
+   block_index = get_bitmap_map_block_index(index);
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map->base + block_index > map->end || index >= map->length) {
+      printf("bitmap_write : index exceeds range\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   #endif
+   bit_indx = get_bitmap_map_block_bit_index(index);
    
-   // set start
-   ret_grp->start = end - ret_grp->length + 1;
+   mask = (map_block) 0x1 << ((MAP_BLOCK_BIT - 1) - bit_indx);
    
-   bitmap_meta_encrypt(map);
+   buf = (input_value & 0x1) << ((MAP_BLOCK_BIT - 1) - bit_indx);
+   buf &= mask;
+   
+   original = *(map->base + block_index) & mask;
+   
+   *(map->base + block_index) &= ~mask;
+   *(map->base + block_index) |= buf;
+   
+   if (buf == 0 && original != 0) {
+      map->number_of_zeros    ++;
+      map->number_of_ones     --;
+   }
+   else if (buf != 0 && original == 0) {
+      map->number_of_zeros    --;
+      map->number_of_ones     ++;
+   }
+   
+   if (map->summary != NULL && buf != original) {
+      map_blocks_summary_update(map, block_index);
+   }
+   if (buf != original) {
+      s_b_rank_touch(map, block_index);
+   }
    
+   if (!no_auto_crypt) {
+      bitmap_meta_encrypt(map);
+   }
+
    return 0;
 }
 
-// both maps must be initialised
-int bitmap_copy (simple_bitmap* src_map, simple_bitmap* dst_map, unsigned char allow_truncate, map_block default_value) {
-   map_block* src_cur;
-   map_block* dst_cur;
-   
-   map_block mask;
-   
-   unsigned char count;
+int bitmap_read_batch (simple_bitmap* map, const bit_index* indices, bit_index count, map_block* results, unsigned char no_auto_crypt) {
+   bit_index i;
    
-   bitmap_meta_decrypt(src_map);
-   bitmap_meta_decrypt(dst_map);
+   if (!no_auto_crypt) {
+      bitmap_meta_decrypt(map);
+   }
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (src_map == NULL) {
-      printf("bitmap_copy : src_map is NULL\n");
-      return WRONG_INPUT;
+   if (map == NULL) {
+      printf("bitmap_read_batch : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
-   if (src_map->base == NULL) {
-      printf("bitmap_copy : src_map->base is NULL\n");
-      return CORRUPTED_DATA;
+   if (map->base == NULL) {
+      printf("bitmap_read_batch : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
-   if (src_map->end == NULL) {
-      printf("bitmap_copy : src_map->end is NULL\n");
-      return CORRUPTED_DATA;
+   if (map->end == NULL) {
+      printf("bitmap_read_batch : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
-   if (src_map->length == 0) {
-      printf("bitmap_copy : src_map has no length\n");
-      return CORRUPTED_DATA;
+   if (map->length == 0) {
+      printf("bitmap_read_batch : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
    }
-   if (src_map->base + get_bitmap_map_block_index(src_map->length-1) != src_map->end) {
-      printf("bitmap_copy : src_map : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_read_batch : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
    }
-   if (src_map->number_of_zeros + src_map->number_of_ones != src_map->length) {
-      printf("bitmap_copy : src_map : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (count > 0 && (indices == NULL || results == NULL)) {
+      printf("bitmap_read_batch : indices or results is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
-   if (dst_map == NULL) {
-      printf("bitmap_copy : dst_map is NULL\n");
-      return WRONG_INPUT;
+   for (i = 0; i < count; i++) {
+      if (indices[i] >= map->length) {
+         printf("bitmap_read_batch : index exceeds range\n");
+         return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+      }
    }
-   if (dst_map->base == NULL) {
-      printf("bitmap_copy : dst_map->base is NULL\n");
-      return CORRUPTED_DATA;
+   #endif
+   
+   for (i = 0; i < count; i++) {
+      results[i] = (map->base[get_bitmap_map_block_index(indices[i])]
+                    >> ((MAP_BLOCK_BIT - 1) - get_bitmap_map_block_bit_index(indices[i]))) & 0x1;
    }
-   if (dst_map->end == NULL) {
-      printf("bitmap_copy : dst_map->end is NULL\n");
-      return CORRUPTED_DATA;
+   
+   if (!no_auto_crypt) {
+      bitmap_meta_encrypt(map);
    }
-   if (dst_map->length == 0) {
-      printf("bitmap_copy : dst_map has no length\n");
-      return CORRUPTED_DATA;
+   
+   return 0;
+}
+
+int bitmap_write_batch (simple_bitmap* map, const bit_index* indices, bit_index count, const map_block* input_values, unsigned char no_auto_crypt) {
+   bit_index i;
+   
+   bit_index block_index;
+   
+   map_block mask;
+   
+   map_block buf;
+   
+   map_block original;
+   
+   if (!no_auto_crypt) {
+      bitmap_meta_decrypt(map);
    }
-   if (dst_map->base + get_bitmap_map_block_index(dst_map->length-1) != dst_map->end) {
-      printf("bitmap_copy : dst_map : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_write_batch : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
-   if (dst_map->number_of_zeros + dst_map->number_of_ones != dst_map->length) {
-      printf("bitmap_copy : dst_map : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (map->base == NULL) {
+      printf("bitmap_write_batch : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_write_batch : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_write_batch : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_write_batch : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_write_batch : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (count > 0 && (indices == NULL || input_values == NULL)) {
+      printf("bitmap_write_batch : indices or input_values is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   // nothing is written unless all indices are valid
+   for (i = 0; i < count; i++) {
+      if (indices[i] >= map->length) {
+         printf("bitmap_write_batch : index exceeds range\n");
+         return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+      }
    }
    #endif
    
-   if (src_map->length <= dst_map->length) { // no need for truncation at all
-   
-      // clean up a bit
-      if (default_value & 0x1) {
-         bitmap_one(dst_map);
-      }
-      else {
-         bitmap_zero(dst_map);
-      }
+   // writes are applied in order, a later write to the same index wins
+   for (i = 0; i < count; i++) {
+      block_index = get_bitmap_map_block_index(indices[i]);
       
-      for (src_cur = src_map->base, dst_cur = dst_map->base;
-            src_cur <= src_map->end;
-            src_cur ++, dst_cur++)
-      {
-         *dst_cur = *src_cur;
-      }
+      mask = (map_block) 0x1 << ((MAP_BLOCK_BIT - 1) - get_bitmap_map_block_bit_index(indices[i]));
       
-      // clean off the edge
-      dst_cur = dst_map->base + (src_map->end - src_map->base);
-      mask = 0;
-      for (count = 0; count <= get_bitmap_map_block_bit_index(src_map->length-1); count++) {
-         mask |= 0x1 << (MAP_BLOCK_BIT - count - 1);
-      }
-      if (default_value & 0x1) {
-         *dst_cur |= ~mask;
-      }
-      else {
-         *dst_cur &= mask;
-      }
-   }
-   else {   // need to truncate
-      if (allow_truncate == 0) {
-         printf("bitmap_copy : truncation needed but not allowed, both maps are untouched\n");
-         return GENERAL_FAIL;
-      }
-   
-      // clean up a bit
-      if (default_value & 0x1) {
-         bitmap_one(dst_map);
-      }
-      else {
-         bitmap_zero(dst_map);
-      }
+      buf = (input_values[i] & 0x1) ? mask : 0;
       
-      for (src_cur = src_map->base, dst_cur = dst_map->base;
-            dst_cur <= dst_map->end;
-            src_cur ++, dst_cur++)
-      {
-         *dst_cur = *src_cur;
-      }
+      original = map->base[block_index] & mask;
       
-      // clean off the edge
-      dst_cur = dst_map->end;
-      mask = 0;
-      for (count = 0; count <= get_bitmap_map_block_bit_index(dst_map->length-1); count++) {
-         mask |= 0x1 << (MAP_BLOCK_BIT - count - 1);
+      if (buf == original) {
+         continue;
       }
-      if (default_value & 0x1) {
-         *dst_cur |= ~mask;
+      
+      map->base[block_index] ^= mask;
+      
+      if (buf == 0) {
+         map->number_of_zeros    ++;
+         map->number_of_ones     --;
       }
       else {
-         *dst_cur &= mask;
+         map->number_of_zeros    --;
+         map->number_of_ones     ++;
+      }
+      
+      if (map->summary != NULL) {
+         map_blocks_summary_update(map, block_index);
       }
+      s_b_rank_touch(map, block_index);
    }
    
-   bitmap_count_zeros_and_ones(dst_map);
-   
-   bitmap_meta_encrypt(src_map);
-   bitmap_meta_encrypt(dst_map);
-   
-   return 0;
-}
-
-int bitmap_meta_copy (simple_bitmap* src_map, simple_bitmap* dst_map) {
-   dst_map->base     =  src_map->base;
-   dst_map->end      =  src_map->end;
-   dst_map->length   =  src_map->length;
+   if (!no_auto_crypt) {
+      bitmap_meta_encrypt(map);
+   }
    
-   dst_map->number_of_zeros   =  src_map->number_of_zeros;
-   dst_map->number_of_ones    =  src_map->number_of_ones;
    return 0;
 }
 
-// memory management is not handled
-// this function only handles meta data and initialise uninitialised map blocks
-int bitmap_grow (simple_bitmap* map, map_block* end, uint_fast32_t size_in_bits, map_block default_value) {
+int bitmap_read_range (simple_bitmap* map, bit_index from, bit_index to, map_block* result, unsigned char no_auto_crypt) {
    map_block* cur;
+   map_block* last;
    
-   map_block mask;
-   
-   map_block* old_end;
-   
-   bit_index old_length;
+   map_block head_mask;
+   map_block tail_mask;
    
-   unsigned char count;
+   // 0x1 - seen one bits, 0x2 - seen zero bits
+   unsigned char seen;
    
-   bitmap_meta_decrypt(map);
+   if (!no_auto_crypt) {
+      bitmap_meta_decrypt(map);
+   }
    
-   //input check
+   // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
    if (map == NULL) {
-      printf("bitmap_grow : map is NULL\n");
-      return WRONG_INPUT;
+      printf("bitmap_read_range : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    if (map->base == NULL) {
-      printf("bitmap_grow : base is NULL\n");
-      return WRONG_INPUT;
+      printf("bitmap_read_range : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    if (map->end == NULL) {
-      printf("bitmap_grow : end is NULL\n");
-      return WRONG_INPUT;
+      printf("bitmap_read_range : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    if (map->length == 0) {
-      printf("bitmap_grow : map has no length\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_read_range : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_grow : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_read_range : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_grow : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+      printf("bitmap_read_range : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (from > to) {
+      printf("bitmap_read_range : from is larger than to\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (to >= map->length) {
+      printf("bitmap_read_range : index exceeds range\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   #endif
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (result == NULL) {
+      printf("bitmap_read_range : result is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
    }
    #endif
    
-   if (end == NULL) {
-      if (size_in_bits == 0) {
-         printf("bitmap_grow : end is NULL but size is 0 as well\n");
-         return WRONG_INPUT;
+   cur = map->base + get_bitmap_map_block_index(from);
+   last = map->base + get_bitmap_map_block_index(to);
+   
+   head_mask = s_b_tail_mask(MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(from));
+   tail_mask = s_b_head_mask(get_bitmap_map_block_bit_index(to) + 1);
+   
+   if (cur == last) {
+      head_mask &= tail_mask;
+   }
+   
+   seen = 0;
+   
+   // head block
+   if ((*cur & head_mask) != 0) {
+      seen |= 0x1;
+   }
+   if ((*cur & head_mask) != head_mask) {
+      seen |= 0x2;
+   }
+   
+   if (cur != last) {
+      // whole blocks in the middle, stop as soon as both bit types are seen
+      for (cur++; cur < last && seen != 0x3; cur++) {
+         if (*cur != 0) {
+            seen |= 0x1;
+         }
+         if (*cur != (map_block) -1) {
+            seen |= 0x2;
+         }
       }
-      if (size_in_bits < map->length) {
-         printf("bitmap_grow : request length is smaller than old length\n");
-         return WRONG_INPUT;
+      
+      // tail block
+      if ((*last & tail_mask) != 0) {
+         seen |= 0x1;
       }
-      if (size_in_bits == map->length) {
-         printf("bitmap_grow : request length is same as old length\n");
-         return WRONG_INPUT;
+      if ((*last & tail_mask) != tail_mask) {
+         seen |= 0x2;
       }
-      old_end = map->end;
-      old_length = map->length;
-      map->end = map->base + get_bitmap_map_block_index(size_in_bits-1);
-      map->length = size_in_bits;
+   }
+   
+   if (seen == 0x1) {
+      *result = 0x1;
+   }
+   else if (seen == 0x2) {
+      *result = 0x0;
    }
    else {
-      if (end < map->end) {
-         printf("bitmap_grow : request end is lower than old end\n");
-         return WRONG_INPUT;
+      *result = 0x2;
+   }
+   
+   if (!no_auto_crypt) {
+      bitmap_meta_encrypt(map);
+   }
+   
+   return 0;
+}
+
+int bitmap_write_range (simple_bitmap* map, bit_index from, bit_index to, map_block input_value, unsigned char no_auto_crypt) {
+   map_block* cur;
+   map_block* first;
+   map_block* last;
+   
+   map_block head_mask;
+   map_block tail_mask;
+   
+   map_block fill;
+   
+   bit_index old_ones;
+   bit_index new_ones;
+   
+   if (!no_auto_crypt) {
+      bitmap_meta_decrypt(map);
+   }
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_write_range : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_write_range : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_write_range : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_write_range : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_write_range : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_write_range : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (from > to) {
+      printf("bitmap_write_range : from is larger than to\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   if (to >= map->length) {
+      printf("bitmap_write_range : index exceeds range\n");
+      return map_blocks_check_fail(WRONG_INPUT, no_auto_crypt ? NULL : map, NULL, NULL);
+   }
+   #endif
+   
+   first = map->base + get_bitmap_map_block_index(from);
+   last = map->base + get_bitmap_map_block_index(to);
+   
+   head_mask = s_b_tail_mask(MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(from));
+   tail_mask = s_b_head_mask(get_bitmap_map_block_bit_index(to) + 1);
+   
+   fill = (input_value & 0x1) ? (map_block) -1 : 0;
+   
+   if (first == last) {
+      head_mask &= tail_mask;
+      
+      old_ones = s_b_popcount(*first & head_mask);
+      
+      *first = (*first & ~head_mask) | (fill & head_mask);
+   }
+   else {
+      // masked head and tail blocks
+      old_ones = s_b_popcount(*first & head_mask) + s_b_popcount(*last & tail_mask);
+      
+      *first = (*first & ~head_mask) | (fill & head_mask);
+      *last = (*last & ~tail_mask) | (fill & tail_mask);
+      
+      // whole blocks in the middle
+      for (cur = first + 1; cur < last; cur++) {
+         old_ones += s_b_popcount(*cur);
       }
-      if (end == map->end) {
-         printf("bitmap_grow : request end is same as old end\n");
-         return WRONG_INPUT;
+      if (last - first > 1) {
+         memset(first + 1, (input_value & 0x1) ? 0xFF : 0x00, sizeof(map_block) * (last - first - 1));
       }
-      old_end = map->end;
-      old_length = map->length;
-      map->end = end;
-      map->length = (end - map->base + 1) * MAP_BLOCK_BIT;
    }
    
-   // clean off the edge and remaining map blocks
-   mask = 0;
-   for (count = 0; count <= get_bitmap_map_block_bit_index(old_length-1); count++) {
-      mask |= 0x1 << (MAP_BLOCK_BIT - count - 1);
+   new_ones = (input_value & 0x1) ? to - from + 1 : 0;
+   
+   map->number_of_ones = map->number_of_ones - old_ones + new_ones;
+   map->number_of_zeros = map->length - map->number_of_ones;
+   
+   if (map->summary != NULL) {
+      for (cur = first; cur <= last; cur++) {
+         map_blocks_summary_update(map, cur - map->base);
+      }
    }
-   if (default_value > 1) {
-      ;     // do nothing
+   s_b_rank_touch(map, first - map->base);
+   
+   if (!no_auto_crypt) {
+      bitmap_meta_encrypt(map);
    }
-   else if (default_value & 0x1) {
-      *old_end |= ~mask;
-      for (cur = old_end + 1; cur <= map->end; cur++) {
-         *cur = (map_block) -1;
+   
+   return 0;
+}
+
+int bitmap_count_zeros_and_ones (simple_bitmap* map) {
+   map_block mask;
+   
+   bit_index ones;
+   
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_count_zeros_and_ones : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_count_zeros_and_ones : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_count_zeros_and_ones : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_count_zeros_and_ones : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_count_zeros_and_ones : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   #endif
+   
+   // clean up the edge
+   mask = s_b_head_mask(get_bitmap_map_block_bit_index(map->length-1) + 1);
+   *(map->end) &= mask;
+   
+   // count one bits a map block at a time
+   ones = map_blocks_parallel_sweep(S_B_OP_COUNT, map->base, NULL, NULL, map->end - map->base + 1);
+   
+   map->number_of_ones = ones;
+   map->number_of_zeros = map->length - ones;
+   
+   if (map->summary != NULL) {
+      map_blocks_summary_rebuild(map);
+   }
+   s_b_rank_touch_all(map);
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_summary_attach (simple_bitmap* map, map_block* summary_base, uint_fast32_t capacity_in_bits) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_summary_attach : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_summary_attach : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_summary_attach : end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_summary_attach : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_summary_attach : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (summary_base == NULL) {
+      printf("bitmap_summary_attach : summary_base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (capacity_in_bits != 0 && capacity_in_bits < map->length) {
+      printf("bitmap_summary_attach : capacity is smaller than length of map\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   if (capacity_in_bits == 0) {
+      capacity_in_bits = map->length;
+   }
+   
+   map->summary = summary_base;
+   map->summary_capacity = capacity_in_bits;
+   
+   map_blocks_summary_rebuild(map);
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_summary_detach (simple_bitmap* map) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_summary_detach : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   map->summary = NULL;
+   map->summary_capacity = 0;
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+// INTERNAL USE, map must be decrypted and have a rank index attached
+// brings the entries of the rank index up to date up to and including entry last
+static void map_blocks_rank_extend (simple_bitmap* map, bit_index last) {
+   bit_index cur;
+   
+   if (map->rank_valid == 0) {
+      map->rank[0] = 0;
+      map->rank_valid = 1;
+   }
+   
+   for (cur = map->rank_valid; cur <= last; cur++) {
+      map->rank[cur] = map->rank[cur-1]
+                       + map_blocks_count_bits(map->base, (cur-1) * BITMAP_RANK_SUPERBLOCK_BIT, BITMAP_RANK_SUPERBLOCK_BIT);
+   }
+   
+   if (map->rank_valid <= last) {
+      map->rank_valid = last + 1;
+   }
+}
+
+// INTERNAL USE, map must be decrypted
+// number of one bits before bit index, index may be equal to the length of the map
+static bit_index map_blocks_rank (simple_bitmap* map, bit_index index) {
+   bit_index entry;
+   
+   if (map->rank == NULL) {
+      // count from whichever end is closer
+      if (index > map->length / 2) {
+         return map->number_of_ones - map_blocks_count_bits(map->base, index, map->length - index);
       }
+      return map_blocks_count_bits(map->base, 0, index);
    }
-   else {
-      *old_end &= mask;
-      for (cur = old_end + 1; cur <= map->end; cur++) {
-         *cur = 0;
+   
+   entry = index / BITMAP_RANK_SUPERBLOCK_BIT;
+   // index is the length of the map and at a superblock boundary
+   if (entry >= get_bitmap_rank_entry_number(map->length)) {
+      entry--;
+   }
+   
+   map_blocks_rank_extend(map, entry);
+   
+   return map->rank[entry] + map_blocks_count_bits(map->base, entry * BITMAP_RANK_SUPERBLOCK_BIT,
+                                                   index - entry * BITMAP_RANK_SUPERBLOCK_BIT);
+}
+
+// INTERNAL USE, map must be decrypted
+// index of the k-th(counted from 0) one bit, the map must have more than k one bits
+static bit_index map_blocks_select (simple_bitmap* map, bit_index k) {
+   bit_index block = 0;
+   bit_index num;
+   
+   bit_index low;
+   bit_index high;
+   bit_index mid;
+   
+   uint64_t word;
+   
+   uint_fast32_t ones;
+   
+   if (map->rank != NULL) {
+      high = get_bitmap_rank_entry_number(map->length) - 1;
+      
+      map_blocks_rank_extend(map, high);
+      
+      // last superblock with at most k one bits before it
+      low = 0;
+      while (low < high) {
+         mid = low + (high - low + 1) / 2;
+         if (map->rank[mid] <= k) {
+            low = mid;
+         }
+         else {
+            high = mid - 1;
+         }
+      }
+      
+      k -= map->rank[low];
+      block = low * S_B_RANK_SUPERBLOCK_BLOCKS;
+   }
+   
+   num = map->end - map->base + 1;
+   
+   // 64 bits at a time, then map block by map block
+   for (; block + S_B_WORD_BLOCKS <= num; block += S_B_WORD_BLOCKS) {
+      word = s_b_word_load(map->base + block);
+      ones = s_b_popcount64(word);
+      if (ones > k) {
+         return block * MAP_BLOCK_BIT + s_b_select64(word, k);
+      }
+      k -= ones;
+   }
+   for (;; block++) {
+      ones = s_b_popcount(map->base[block]);
+      if (ones > k) {
+         return block * MAP_BLOCK_BIT + s_b_select64((uint64_t) map->base[block] << (64 - MAP_BLOCK_BIT), k);
       }
+      k -= ones;
+   }
+}
+
+int bitmap_rank_attach (simple_bitmap* map, bit_index* rank_base, uint_fast32_t capacity_in_bits) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_rank_attach : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_rank_attach : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_rank_attach : end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_rank_attach : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_rank_attach : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (rank_base == NULL) {
+      printf("bitmap_rank_attach : rank_base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (capacity_in_bits != 0 && capacity_in_bits < map->length) {
+      printf("bitmap_rank_attach : capacity is smaller than length of map\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   if (capacity_in_bits == 0) {
+      capacity_in_bits = map->length;
+   }
+   
+   map->rank = rank_base;
+   map->rank_capacity = capacity_in_bits;
+   
+   // entries are counted on first use
+   map->rank[0] = 0;
+   map->rank_valid = 1;
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_rank_detach (simple_bitmap* map) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_rank_detach : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   map->rank = NULL;
+   map->rank_capacity = 0;
+   map->rank_valid = 0;
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_rank (simple_bitmap* map, bit_index index, bit_index* result) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_rank : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_rank : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_rank : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_rank : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_rank : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_rank : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (index > map->length) {
+      printf("bitmap_rank : index exceeds range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (result == NULL) {
+      printf("bitmap_rank : result is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   *result = map_blocks_rank(map, index);
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_count_range (simple_bitmap* map, bit_index from, bit_index to, bit_index* result) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_count_range : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_count_range : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_count_range : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_count_range : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_count_range : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_count_range : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (from > to) {
+      printf("bitmap_count_range : from is larger than to\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (to >= map->length) {
+      printf("bitmap_count_range : index exceeds range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (result == NULL) {
+      printf("bitmap_count_range : result is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   // short ranges are cheaper to count directly
+   if (map->rank != NULL && to - from >= BITMAP_RANK_SUPERBLOCK_BIT) {
+      *result = map_blocks_rank(map, to + 1) - map_blocks_rank(map, from);
+   }
+   else {
+      *result = map_blocks_count_bits(map->base, from, to - from + 1);
+   }
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_select (simple_bitmap* map, bit_index k, bit_index* result) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_select : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_select : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_select : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_select : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_select : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_select : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (result == NULL) {
+      printf("bitmap_select : result is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   if (k >= map->number_of_ones) {
+      bitmap_meta_encrypt(map);
+      return SEARCH_FAIL;
+   }
+   
+   *result = map_blocks_select(map, k);
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_checkout (simple_bitmap* map, bitmap_handle* handle) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_checkout : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (handle == NULL) {
+      printf("bitmap_checkout : handle is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_checkout : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_checkout : end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_checkout : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_checkout : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_checkout : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   #endif
+   
+   handle->map = map;
+   handle->base = map->base;
+   handle->length = map->length;
+   
+   return 0;
+}
+
+int bitmap_release (bitmap_handle* handle) {
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (handle == NULL) {
+      printf("bitmap_release : handle is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (handle->map == NULL) {
+      printf("bitmap_release : handle is not checked out\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   bitmap_meta_encrypt(handle->map);
+   
+   handle->map = NULL;
+   handle->base = NULL;
+   handle->length = 0;
+   
+   return 0;
+}
+
+int bitmap_handle_summary_update (bitmap_handle* handle, bit_index index) {
+   s_b_rank_touch(handle->map, get_bitmap_map_block_index(index));
+   
+   if (handle->map->summary == NULL) {
+      return 0;
+   }
+   
+   return map_blocks_summary_update(handle->map, get_bitmap_map_block_index(index));
+}
+
+#ifdef SIMPLE_BITMAP_ATOMIC
+static long s_b_atomic_thread_count;
+
+static s_b_thread_local long s_b_atomic_thread_id;   // 0 means not assigned yet
+
+// INTERNAL USE
+// each thread is given an id the first time it asks, and sticks to the stripe of that id
+static long* map_blocks_atomic_stripe (bitmap_atomic* amap) {
+   if (s_b_atomic_thread_id == 0) {
+      s_b_atomic_thread_id = s_b_atomic_count_add(&s_b_atomic_thread_count, 1);
+   }
+   
+   return &amap->stripes[s_b_atomic_thread_id % SIMPLE_BITMAP_ATOMIC_STRIPES].ones_delta;
+}
+
+int bitmap_atomic_begin (bitmap_handle* handle, bitmap_atomic* amap) {
+   int i;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (handle == NULL) {
+      printf("bitmap_atomic_begin : handle is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (amap == NULL) {
+      printf("bitmap_atomic_begin : amap is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (handle->map == NULL) {
+      printf("bitmap_atomic_begin : handle is not checked out\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   amap->handle = handle;
+   
+   for (i = 0; i < SIMPLE_BITMAP_ATOMIC_STRIPES; i++) {
+      amap->stripes[i].ones_delta = 0;
+   }
+   
+   return 0;
+}
+
+int bitmap_atomic_end (bitmap_atomic* amap) {
+   simple_bitmap* map;
+   
+   bit_index ones;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (amap == NULL) {
+      printf("bitmap_atomic_end : amap is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (amap->handle == NULL || amap->handle->map == NULL) {
+      printf("bitmap_atomic_end : handle is not checked out\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   map = amap->handle->map;
+   
+   ones = bitmap_atomic_count_ones(amap);
+   
+   map->number_of_ones = ones;
+   map->number_of_zeros = map->length - ones;
+   
+   if (map->summary != NULL) {
+      map_blocks_summary_rebuild(map);
+   }
+   s_b_rank_touch_all(map);
+   
+   amap->handle = NULL;
+   
+   return 0;
+}
+
+map_block bitmap_atomic_read (bitmap_atomic* amap, bit_index index) {
+   return (s_b_atomic_load(amap->handle->base + get_bitmap_map_block_index(index))
+            >> (MAP_BLOCK_BIT - 1 - get_bitmap_map_block_bit_index(index))) & 0x1;
+}
+
+int bitmap_atomic_write (bitmap_atomic* amap, bit_index index, map_block input_value) {
+   if (input_value & 0x1) {
+      bitmap_atomic_test_and_set(amap, index);
+   }
+   else {
+      bitmap_atomic_test_and_clear(amap, index);
+   }
+   
+   return 0;
+}
+
+map_block bitmap_atomic_test_and_set (bitmap_atomic* amap, bit_index index) {
+   map_block mask = (map_block) 0x1 << (MAP_BLOCK_BIT - 1 - get_bitmap_map_block_bit_index(index));
+   
+   map_block old_block = s_b_atomic_fetch_or(amap->handle->base + get_bitmap_map_block_index(index), mask);
+   
+   if (old_block & mask) {
+      return 1;
+   }
+   
+   s_b_atomic_count_add(map_blocks_atomic_stripe(amap), 1);
+   
+   return 0;
+}
+
+map_block bitmap_atomic_test_and_clear (bitmap_atomic* amap, bit_index index) {
+   map_block mask = (map_block) 0x1 << (MAP_BLOCK_BIT - 1 - get_bitmap_map_block_bit_index(index));
+   
+   map_block old_block = s_b_atomic_fetch_and(amap->handle->base + get_bitmap_map_block_index(index), (map_block) ~mask);
+   
+   if (!(old_block & mask)) {
+      return 0;
+   }
+   
+   s_b_atomic_count_add(map_blocks_atomic_stripe(amap), -1);
+   
+   return 1;
+}
+
+bit_index bitmap_atomic_count_ones (bitmap_atomic* amap) {
+   long delta = 0;
+   
+   int i;
+   
+   for (i = 0; i < SIMPLE_BITMAP_ATOMIC_STRIPES; i++) {
+      delta += s_b_atomic_count_load(&amap->stripes[i].ones_delta);
+   }
+   
+   return amap->handle->map->number_of_ones + delta;
+}
+#endif
+
+// INTERNAL USE, map must be decrypted and checked
+// returns index of the first bit equal to bit_type at or after from,
+// or map->length if there is none
+static bit_index map_blocks_find_bit_fwd (simple_bitmap* map, bit_index from, map_block bit_type) {
+   map_block* base = map->base;
+   
+   bit_index last = map->end - map->base;
+   bit_index block;
+   bit_index result;
+   
+   // search for one bits in the inverted map blocks when looking for zeros
+   map_block invert = bit_type ? 0 : (map_block) -1;
+   
+   map_block buf;
+   
+   block = get_bitmap_map_block_index(from);
+   
+   // mask skipped bits
+   buf = (map_block) (base[block] ^ invert) & s_b_tail_mask(MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(from));
+   
+   while (buf == 0) {
+      if (map->summary != NULL) {
+         // jump straight to the next candidate map block
+         block = map_blocks_summary_next(map, block + 1, bit_type);
+         if (block > last) {
+            return map->length;
+         }
+         buf = base[block] ^ invert;
+         continue;
+      }
+      
+      // skip four map blocks at a time in long runs
+      while (block + 4 <= last
+             && (map_block) ((base[block+1] ^ invert) | (base[block+2] ^ invert)
+                           | (base[block+3] ^ invert) | (base[block+4] ^ invert)) == 0) {
+         block += 4;
+      }
+      
+      if (block == last) {
+         return map->length;
+      }
+      
+      block++;
+      buf = base[block] ^ invert;
+   }
+   
+   result = block * MAP_BLOCK_BIT + s_b_clz(buf);
+   
+   // padding bits of the last map block show up as ones when inverted
+   return result < map->length ? result : map->length;
+}
+
+// INTERNAL USE, map must be decrypted and checked
+// returns index of the last bit equal to bit_type at or before from,
+// or map->length if there is none
+static bit_index map_blocks_find_bit_back (simple_bitmap* map, bit_index from, map_block bit_type) {
+   map_block* base = map->base;
+   
+   bit_index last = map->end - map->base;
+   bit_index block;
+   
+   map_block invert = bit_type ? 0 : (map_block) -1;
+   
+   map_block buf;
+   
+   block = get_bitmap_map_block_index(from);
+   
+   // mask skipped bits
+   buf = (map_block) (base[block] ^ invert) & s_b_head_mask(get_bitmap_map_block_bit_index(from) + 1);
+   
+   while (buf == 0) {
+      if (map->summary != NULL) {
+         // jump straight to the previous candidate map block
+         if (block == 0) {
+            return map->length;
+         }
+         block = map_blocks_summary_prev(map, block - 1, bit_type);
+         if (block > last) {
+            return map->length;
+         }
+         buf = base[block] ^ invert;
+         continue;
+      }
+      
+      // skip four map blocks at a time in long runs
+      while (block >= 4
+             && (map_block) ((base[block-1] ^ invert) | (base[block-2] ^ invert)
+                           | (base[block-3] ^ invert) | (base[block-4] ^ invert)) == 0) {
+         block -= 4;
+      }
+      
+      if (block == 0) {
+         return map->length;
+      }
+      
+      block--;
+      buf = base[block] ^ invert;
+   }
+   
+   return block * MAP_BLOCK_BIT + (MAP_BLOCK_BIT - 1 - s_b_ctz(buf));
+}
+
+int bitmap_first_one_bit_index (simple_bitmap* map, bit_index* result, bit_index skip_to_bit) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_first_one_bit_index : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_first_one_bit_index : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_first_one_bit_index : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_first_one_bit_index : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_first_one_bit_index : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_first_one_bit_index : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (result == NULL) {
+      printf("bitmap_first_one_bit_index : result is null\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_first_one_bit_index : skip_to_bit is out of range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   *result = map_blocks_find_bit_fwd(map, skip_to_bit, 0x1);
+   
+   if (*result >= map->length) {
+      bitmap_meta_encrypt(map);
+      return SEARCH_FAIL;
+   }
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_first_zero_bit_index (simple_bitmap* map, bit_index* result, bit_index skip_to_bit) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_first_zero_bit_index : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_first_zero_bit_index : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_first_zero_bit_index : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_first_zero_bit_index : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_first_zero_bit_index : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_first_zero_bit_index : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_first_zero_bit_index : skip_to_bit is out of range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   *result = map_blocks_find_bit_fwd(map, skip_to_bit, 0x0);
+   
+   if (*result >= map->length) {
+      bitmap_meta_encrypt(map);
+      return SEARCH_FAIL;
+   }
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_first_one_cont_group (simple_bitmap* map, bitmap_cont_group* ret_grp, bit_index skip_to_bit) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_first_one_cont_group : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_first_one_cont_group : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_first_one_cont_group : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_first_one_cont_group : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_first_one_cont_group : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_first_one_cont_group : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (ret_grp == NULL) {
+      printf("bitmap_first_one_cont_group : ret_grp is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_first_one_cont_group : skip_to_bit is out of range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   // setup return group
+   ret_grp->bit_type = 0x1;
+   ret_grp->start = map_blocks_find_bit_fwd(map, skip_to_bit, 0x1);
+   ret_grp->length = 0;
+   
+   if (ret_grp->start >= map->length) {
+      bitmap_meta_encrypt(map);
+      return SEARCH_FAIL;
+   }
+   
+   // the group ends right before the next bit of the other type
+   ret_grp->length = map_blocks_find_bit_fwd(map, ret_grp->start, 0x0) - ret_grp->start;
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_first_zero_cont_group (simple_bitmap* map, bitmap_cont_group* ret_grp, bit_index skip_to_bit) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_first_zero_cont_group : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_first_zero_cont_group : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_first_zero_cont_group : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_first_zero_cont_group : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_first_zero_cont_group : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_first_zero_cont_group : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (ret_grp == NULL) {
+      printf("bitmap_first_zero_cont_group : ret_grp is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_first_zero_cont_group : skip_to_bit is out of range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   // setup return group
+   ret_grp->bit_type = 0x0;
+   ret_grp->start = map_blocks_find_bit_fwd(map, skip_to_bit, 0x0);
+   ret_grp->length = 0;
+   
+   if (ret_grp->start >= map->length) {
+      bitmap_meta_encrypt(map);
+      return SEARCH_FAIL;
+   }
+   
+   // the group ends right before the next bit of the other type
+   ret_grp->length = map_blocks_find_bit_fwd(map, ret_grp->start, 0x1) - ret_grp->start;
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_first_one_bit_index_back (simple_bitmap* map, bit_index* result, bit_index skip_to_bit) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_first_one_bit_index_back : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_first_one_bit_index_back : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_first_one_bit_index_back : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_first_one_bit_index_back : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_first_one_bit_index_back : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_first_one_bit_index_back : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (result == NULL) {
+      printf("bitmap_first_one_bit_index_back : result is null\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_first_one_bit_index_back : skip_to_bit is out of range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   *result = map_blocks_find_bit_back(map, skip_to_bit, 0x1);
+   
+   if (*result >= map->length) {
+      bitmap_meta_encrypt(map);
+      return SEARCH_FAIL;
+   }
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_first_zero_bit_index_back (simple_bitmap* map, bit_index* result, bit_index skip_to_bit) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_first_zero_bit_index_back : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_first_zero_bit_index_back : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_first_zero_bit_index_back : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_first_zero_bit_index_back : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_first_zero_bit_index_back : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_first_zero_bit_index_back : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_first_zero_bit_index_back : skip_to_bit is out of range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   *result = map_blocks_find_bit_back(map, skip_to_bit, 0x0);
+   
+   if (*result >= map->length) {
+      bitmap_meta_encrypt(map);
+      return SEARCH_FAIL;
+   }
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_first_one_cont_group_back (simple_bitmap* map, bitmap_cont_group* ret_grp, bit_index skip_to_bit) {
+   bit_index end;
+   
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_first_one_cont_group_back : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_first_one_cont_group_back : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_first_one_cont_group_back : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_first_one_cont_group_back : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_first_one_cont_group_back : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_first_one_cont_group_back : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (ret_grp == NULL) {
+      printf("bitmap_first_one_cont_group_back : ret_grp is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_first_one_cont_group_back : skip_to_bit is out of range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   // setup return group
+   ret_grp->bit_type = 0x1;
+   ret_grp->start = 0;
+   ret_grp->length = 0;
+   
+   end = map_blocks_find_bit_back(map, skip_to_bit, 0x1);
+   
+   if (end >= map->length) {
+      bitmap_meta_encrypt(map);
+      return SEARCH_FAIL;
+   }
+   
+   // the group starts right after the previous bit of the other type
+   ret_grp->start = map_blocks_find_bit_back(map, end, 0x0);
+   if (ret_grp->start >= map->length) {
+      ret_grp->start = 0;
+   }
+   else {
+      ret_grp->start++;
+   }
+   ret_grp->length = end - ret_grp->start + 1;
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_first_zero_cont_group_back (simple_bitmap* map, bitmap_cont_group* ret_grp, bit_index skip_to_bit) {
+   bit_index end;
+   
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_first_zero_cont_group_back : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_first_zero_cont_group_back : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_first_zero_cont_group_back : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_first_zero_cont_group_back : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_first_zero_cont_group_back : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_first_zero_cont_group_back : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (ret_grp == NULL) {
+      printf("bitmap_first_zero_cont_group_back : ret_grp is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_first_zero_cont_group_back : skip_to_bit is out of range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   // setup return group
+   ret_grp->bit_type = 0x0;
+   ret_grp->start = 0;
+   ret_grp->length = 0;
+   
+   end = map_blocks_find_bit_back(map, skip_to_bit, 0x0);
+   
+   if (end >= map->length) {
+      bitmap_meta_encrypt(map);
+      return SEARCH_FAIL;
+   }
+   
+   // the group starts right after the previous bit of the other type
+   ret_grp->start = map_blocks_find_bit_back(map, end, 0x1);
+   if (ret_grp->start >= map->length) {
+      ret_grp->start = 0;
+   }
+   else {
+      ret_grp->start++;
+   }
+   ret_grp->length = end - ret_grp->start + 1;
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+// INTERNAL USE, map must be decrypted and checked
+// same as map_blocks_find_bit_fwd, but looks at the map block holding from first,
+// which is where most group boundaries are found when walking over all groups
+static bit_index map_blocks_iter_fwd (simple_bitmap* map, bit_index from, map_block bit_type) {
+   bit_index block = get_bitmap_map_block_index(from);
+   bit_index result;
+   
+   map_block buf;
+   
+   buf = (map_block) (map->base[block] ^ (bit_type ? 0 : (map_block) -1))
+            & s_b_tail_mask(MAP_BLOCK_BIT - get_bitmap_map_block_bit_index(from));
+   
+   if (buf != 0) {
+      result = block * MAP_BLOCK_BIT + s_b_clz(buf);
+      return result < map->length ? result : map->length;
+   }
+   
+   if (map->base + block == map->end) {
+      return map->length;
+   }
+   
+   return map_blocks_find_bit_fwd(map, (block + 1) * MAP_BLOCK_BIT, bit_type);
+}
+
+// INTERNAL USE, map must be decrypted and checked
+// backward version of map_blocks_iter_fwd
+static bit_index map_blocks_iter_back (simple_bitmap* map, bit_index from, map_block bit_type) {
+   bit_index block = get_bitmap_map_block_index(from);
+   
+   map_block buf;
+   
+   buf = (map_block) (map->base[block] ^ (bit_type ? 0 : (map_block) -1))
+            & s_b_head_mask(get_bitmap_map_block_bit_index(from) + 1);
+   
+   if (buf != 0) {
+      return block * MAP_BLOCK_BIT + (MAP_BLOCK_BIT - 1 - s_b_ctz(buf));
+   }
+   
+   if (block == 0) {
+      return map->length;
+   }
+   
+   return map_blocks_find_bit_back(map, block * MAP_BLOCK_BIT - 1, bit_type);
+}
+
+int bitmap_cont_group_iter_init (simple_bitmap* map, bitmap_cont_group_iter* iter, map_block bit_type, char direction, bit_index skip_to_bit) {
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_cont_group_iter_init : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_cont_group_iter_init : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_cont_group_iter_init : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_cont_group_iter_init : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_cont_group_iter_init : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_cont_group_iter_init : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (iter == NULL) {
+      printf("bitmap_cont_group_iter_init : iter is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_cont_group_iter_init : skip_to_bit is out of range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   // only the map is kept, its meta data is decrypted again for each step instead of keeping a plain copy
+   iter->map = map;
+   iter->bit_type = bit_type;
+   iter->direction = direction;
+   iter->pos = direction >= 0 ? skip_to_bit : skip_to_bit + 1;
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_cont_group_iter_next (bitmap_cont_group_iter* iter, bitmap_cont_group* ret_grp) {
+   simple_bitmap* map;
+   
+   map_block bit_type;
+   
+   bit_index start;
+   bit_index last;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (iter == NULL) {
+      printf("bitmap_cont_group_iter_next : iter is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (ret_grp == NULL) {
+      printf("bitmap_cont_group_iter_next : ret_grp is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (iter->map == NULL) {
+      printf("bitmap_cont_group_iter_next : iter->map is NULL\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   map = iter->map;
+   
+   bitmap_meta_decrypt(map);
+   
+   if (iter->direction >= 0) {
+      if (iter->pos >= map->length) {
+         return map_blocks_check_fail(SEARCH_FAIL, map, NULL, NULL);
+      }
+      
+      if (iter->bit_type > 1) {
+         // the group is of whatever type the next bit is
+         start = iter->pos;
+         bit_type = (map->base[get_bitmap_map_block_index(start)]
+                        >> (MAP_BLOCK_BIT - 1 - get_bitmap_map_block_bit_index(start))) & 0x1;
+      }
+      else {
+         bit_type = iter->bit_type;
+         start = map_blocks_iter_fwd(map, iter->pos, bit_type);
+         if (start >= map->length) {
+            iter->pos = map->length;
+            return map_blocks_check_fail(SEARCH_FAIL, map, NULL, NULL);
+         }
+      }
+      
+      // the group ends right before the next bit of the other type
+      iter->pos = map_blocks_iter_fwd(map, start, !bit_type);
+      
+      ret_grp->bit_type = bit_type;
+      ret_grp->start = start;
+      ret_grp->length = iter->pos - start;
+   }
+   else {
+      if (iter->pos == 0) {
+         return map_blocks_check_fail(SEARCH_FAIL, map, NULL, NULL);
+      }
+      
+      if (iter->bit_type > 1) {
+         last = iter->pos - 1;
+         bit_type = (map->base[get_bitmap_map_block_index(last)]
+                        >> (MAP_BLOCK_BIT - 1 - get_bitmap_map_block_bit_index(last))) & 0x1;
+      }
+      else {
+         bit_type = iter->bit_type;
+         last = map_blocks_iter_back(map, iter->pos - 1, bit_type);
+         if (last >= map->length) {
+            iter->pos = 0;
+            return map_blocks_check_fail(SEARCH_FAIL, map, NULL, NULL);
+         }
+      }
+      
+      // the group starts right after the previous bit of the other type
+      start = map_blocks_iter_back(map, last, !bit_type);
+      start = start >= map->length ? 0 : start + 1;
+      
+      iter->pos = start;
+      
+      ret_grp->bit_type = bit_type;
+      ret_grp->start = start;
+      ret_grp->length = last - start + 1;
+   }
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+// INTERNAL USE
+// writes the indices of the one bits from bit from to bit to(inclusive) into out, at most max of them,
+// returns the number written, *next is set to the bit to carry on from(to + 1 once all are written)
+static bit_index map_blocks_decode_ones (map_block* blocks, bit_index from, bit_index to, bit_index* out, bit_index max, bit_index* next) {
+   bit_index n = 0;
+   
+   bit_index block;
+   bit_index last;
+   bit_index bit;
+   
+   uint64_t word;
+   
+   uint_fast32_t width;
+   uint_fast32_t pos;
+   
+   block = get_bitmap_map_block_index(from);
+   last = get_bitmap_map_block_index(to);
+   
+   while (block <= last) {
+      // 64 bits at a time where possible, left aligned map blocks otherwise
+      if (block + S_B_WORD_BLOCKS <= last + 1) {
+         word = s_b_word_load(blocks + block);
+         width = 64;
+      }
+      else {
+         word = (uint64_t) blocks[block] << (64 - MAP_BLOCK_BIT);
+         width = MAP_BLOCK_BIT;
+      }
+      bit = block * MAP_BLOCK_BIT;
+      
+      // drop bits before from and after to
+      if (bit < from) {
+         word &= (uint64_t) -1 >> (from - bit);
+      }
+      if (bit + width - 1 > to) {
+         word &= ~((uint64_t) -1 >> (to - bit + 1));
+      }
+      
+      while (word != 0) {
+         pos = s_b_clz64(word);
+         if (n == max) {
+            *next = bit + pos;
+            return n;
+         }
+         out[n++] = bit + pos;
+         word ^= (uint64_t) 0x1 << (63 - pos);
+      }
+      
+      block += width / MAP_BLOCK_BIT;
+   }
+   
+   *next = to + 1;
+   
+   return n;
+}
+
+int bitmap_for_each_one (simple_bitmap* map, bit_index from, bit_index to, int (*callback) (bit_index, void*), void* arg) {
+   bit_index buf[S_B_DECODE_BUF_NUM];
+   
+   bit_index n;
+   bit_index i;
+   
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_for_each_one : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_for_each_one : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_for_each_one : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_for_each_one : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_for_each_one : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (from > to) {
+      printf("bitmap_for_each_one : from is larger than to\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (to >= map->length) {
+      printf("bitmap_for_each_one : index exceeds range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (callback == NULL) {
+      printf("bitmap_for_each_one : callback is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   // decode a buffer full at a time, then hand the indices out
+   while (from <= to) {
+      n = map_blocks_decode_ones(map->base, from, to, buf, S_B_DECODE_BUF_NUM, &from);
+      
+      for (i = 0; i < n; i++) {
+         if (callback(buf[i], arg)) {
+            bitmap_meta_encrypt(map);
+            return 0;
+         }
+      }
+   }
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_to_indices (simple_bitmap* map, bit_index skip_to_bit, bit_index* out, bit_index max, bit_index* count) {
+   bit_index next;
+   
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_to_indices : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_to_indices : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_to_indices : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_to_indices : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_to_indices : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (skip_to_bit > map->length) {
+      printf("bitmap_to_indices : skip_to_bit is out of range\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (count == NULL || (out == NULL && max > 0)) {
+      printf("bitmap_to_indices : out or count is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   #endif
+   
+   if (skip_to_bit == map->length) {
+      *count = 0;
+   }
+   else {
+      *count = map_blocks_decode_ones(map->base, skip_to_bit, map->length - 1, out, max, &next);
+   }
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_from_indices (simple_bitmap* map, const bit_index* indices, bit_index count) {
+   bit_index i;
+   
+   bit_index ones;
+   
+   map_block mask;
+   
+   map_block* cur;
+   
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_from_indices : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_from_indices : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_from_indices : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_from_indices : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_from_indices : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (indices == NULL && count > 0) {
+      printf("bitmap_from_indices : indices is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   // the map is left as it is unless all indices are valid
+   for (i = 0; i < count; i++) {
+      if (indices[i] >= map->length) {
+         printf("bitmap_from_indices : index exceeds range\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+   }
+   #endif
+   
+   memset(map->base, 0x00, sizeof(map_block) * (map->end - map->base + 1));
+   
+   // repeated indices are counted once
+   ones = 0;
+   for (i = 0; i < count; i++) {
+      cur = map->base + get_bitmap_map_block_index(indices[i]);
+      mask = (map_block) 0x1 << (MAP_BLOCK_BIT - 1 - get_bitmap_map_block_bit_index(indices[i]));
+      ones += !(*cur & mask);
+      *cur |= mask;
+   }
+   
+   map->number_of_ones = ones;
+   map->number_of_zeros = map->length - ones;
+   
+   if (map->summary != NULL) {
+      map_blocks_summary_rebuild(map);
+   }
+   s_b_rank_touch_all(map);
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+// both maps must be initialised
+int bitmap_copy (simple_bitmap* src_map, simple_bitmap* dst_map, unsigned char allow_truncate, map_block default_value) {
+   map_block* dst_cur;
+   
+   map_block mask;
+   
+   bitmap_meta_decrypt(src_map);
+   bitmap_meta_decrypt(dst_map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (src_map == NULL) {
+      printf("bitmap_copy : src_map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, src_map, dst_map, NULL);
+   }
+   if (src_map->base == NULL) {
+      printf("bitmap_copy : src_map->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (src_map->end == NULL) {
+      printf("bitmap_copy : src_map->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (src_map->length == 0) {
+      printf("bitmap_copy : src_map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (src_map->base + get_bitmap_map_block_index(src_map->length-1) != src_map->end) {
+      printf("bitmap_copy : src_map : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (src_map->number_of_zeros + src_map->number_of_ones != src_map->length) {
+      printf("bitmap_copy : src_map : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (dst_map == NULL) {
+      printf("bitmap_copy : dst_map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, src_map, dst_map, NULL);
+   }
+   if (dst_map->base == NULL) {
+      printf("bitmap_copy : dst_map->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (dst_map->end == NULL) {
+      printf("bitmap_copy : dst_map->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (dst_map->length == 0) {
+      printf("bitmap_copy : dst_map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (dst_map->base + get_bitmap_map_block_index(dst_map->length-1) != dst_map->end) {
+      printf("bitmap_copy : dst_map : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (dst_map->number_of_zeros + dst_map->number_of_ones != dst_map->length) {
+      printf("bitmap_copy : dst_map : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   #endif
+   
+   if (src_map->length <= dst_map->length) { // no need for truncation at all
+   
+      // clean up a bit
+      if (default_value & 0x1) {
+         bitmap_one(dst_map);
+      }
+      else {
+         bitmap_zero(dst_map);
+      }
+      
+      map_blocks_parallel_sweep(S_B_OP_COPY, dst_map->base, src_map->base, NULL, src_map->end - src_map->base + 1);
+      
+      // clean off the edge
+      dst_cur = dst_map->base + (src_map->end - src_map->base);
+      mask = s_b_head_mask(get_bitmap_map_block_bit_index(src_map->length-1) + 1);
+      if (default_value & 0x1) {
+         *dst_cur |= ~mask;
+      }
+      else {
+         *dst_cur &= mask;
+      }
+   }
+   else {   // need to truncate
+      if (allow_truncate == 0) {
+         printf("bitmap_copy : truncation needed but not allowed, both maps are untouched\n");
+         return map_blocks_check_fail(GENERAL_FAIL, src_map, dst_map, NULL);
+      }
+   
+      // clean up a bit
+      if (default_value & 0x1) {
+         bitmap_one(dst_map);
+      }
+      else {
+         bitmap_zero(dst_map);
+      }
+      
+      map_blocks_parallel_sweep(S_B_OP_COPY, dst_map->base, src_map->base, NULL, dst_map->end - dst_map->base + 1);
+      
+      // clean off the edge
+      dst_cur = dst_map->end;
+      mask = s_b_head_mask(get_bitmap_map_block_bit_index(dst_map->length-1) + 1);
+      if (default_value & 0x1) {
+         *dst_cur |= ~mask;
+      }
+      else {
+         *dst_cur &= mask;
+      }
+   }
+   
+   bitmap_count_zeros_and_ones(dst_map);
+   
+   bitmap_meta_encrypt(src_map);
+   bitmap_meta_encrypt(dst_map);
+   
+   return 0;
+}
+
+int bitmap_copy_range (simple_bitmap* src_map, bit_index src_from, simple_bitmap* dst_map, bit_index dst_from, bit_index count) {
+   bit_index old_ones;
+   bit_index new_ones;
+   
+   bit_index block;
+   
+   bitmap_meta_decrypt(src_map);
+   if (dst_map != src_map) {
+      bitmap_meta_decrypt(dst_map);
+   }
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (src_map == NULL) {
+      printf("bitmap_copy_range : src_map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, src_map, dst_map, NULL);
+   }
+   if (src_map->base == NULL) {
+      printf("bitmap_copy_range : src_map->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (src_map->end == NULL) {
+      printf("bitmap_copy_range : src_map->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (src_map->length == 0) {
+      printf("bitmap_copy_range : src_map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (src_map->base + get_bitmap_map_block_index(src_map->length-1) != src_map->end) {
+      printf("bitmap_copy_range : src_map : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (src_map->number_of_zeros + src_map->number_of_ones != src_map->length) {
+      printf("bitmap_copy_range : src_map : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (dst_map == NULL) {
+      printf("bitmap_copy_range : dst_map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, src_map, dst_map, NULL);
+   }
+   if (dst_map->base == NULL) {
+      printf("bitmap_copy_range : dst_map->base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (dst_map->end == NULL) {
+      printf("bitmap_copy_range : dst_map->end is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (dst_map->length == 0) {
+      printf("bitmap_copy_range : dst_map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (dst_map->base + get_bitmap_map_block_index(dst_map->length-1) != dst_map->end) {
+      printf("bitmap_copy_range : dst_map : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (dst_map->number_of_zeros + dst_map->number_of_ones != dst_map->length) {
+      printf("bitmap_copy_range : dst_map : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, src_map, dst_map, NULL);
+   }
+   if (src_from > src_map->length || count > src_map->length - src_from) {
+      printf("bitmap_copy_range : range exceeds src_map\n");
+      return map_blocks_check_fail(WRONG_INPUT, src_map, dst_map, NULL);
+   }
+   if (dst_from > dst_map->length || count > dst_map->length - dst_from) {
+      printf("bitmap_copy_range : range exceeds dst_map\n");
+      return map_blocks_check_fail(WRONG_INPUT, src_map, dst_map, NULL);
+   }
+   #endif
+   
+   if (count == 0) {
+      bitmap_meta_encrypt(src_map);
+      if (dst_map != src_map) {
+         bitmap_meta_encrypt(dst_map);
+      }
+      return 0;
+   }
+   
+   old_ones = map_blocks_count_bits(dst_map->base, dst_from, count);
+   new_ones = map_blocks_count_bits(src_map->base, src_from, count);
+   
+   map_blocks_move_bits(dst_map->base, dst_from, src_map->base, src_from, count);
+   
+   dst_map->number_of_ones = dst_map->number_of_ones - old_ones + new_ones;
+   dst_map->number_of_zeros = dst_map->length - dst_map->number_of_ones;
+   
+   if (dst_map->summary != NULL) {
+      for (block = get_bitmap_map_block_index(dst_from);
+            block <= get_bitmap_map_block_index(dst_from + count - 1); block++) {
+         map_blocks_summary_update(dst_map, block);
+      }
+   }
+   s_b_rank_touch(dst_map, get_bitmap_map_block_index(dst_from));
+   
+   bitmap_meta_encrypt(src_map);
+   if (dst_map != src_map) {
+      bitmap_meta_encrypt(dst_map);
+   }
+   
+   return 0;
+}
+
+int bitmap_meta_copy (simple_bitmap* src_map, simple_bitmap* dst_map) {
+   dst_map->base     =  src_map->base;
+   dst_map->end      =  src_map->end;
+   dst_map->length   =  src_map->length;
+   
+   dst_map->number_of_zeros   =  src_map->number_of_zeros;
+   dst_map->number_of_ones    =  src_map->number_of_ones;
+   
+   dst_map->summary           =  src_map->summary;
+   dst_map->summary_capacity  =  src_map->summary_capacity;
+   
+   dst_map->rank              =  src_map->rank;
+   dst_map->rank_capacity     =  src_map->rank_capacity;
+   dst_map->rank_valid        =  src_map->rank_valid;
+   return 0;
+}
+
+// memory management is not handled
+// this function only handles meta data and initialise uninitialised map blocks
+int bitmap_grow (simple_bitmap* map, map_block* end, uint_fast32_t size_in_bits, map_block default_value) {
+   map_block* cur;
+   
+   map_block mask;
+   
+   map_block* old_end;
+   
+   bit_index old_length;
+   
+   bitmap_meta_decrypt(map);
+   
+   //input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_grow : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_grow : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_grow : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_grow : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_grow : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_grow : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   #endif
+   
+   if (end == NULL) {
+      if (size_in_bits == 0) {
+         printf("bitmap_grow : end is NULL but size is 0 as well\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+      if (size_in_bits < map->length) {
+         printf("bitmap_grow : request length is smaller than old length\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+      if (size_in_bits == map->length) {
+         printf("bitmap_grow : request length is same as old length\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+      old_end = map->end;
+      old_length = map->length;
+      map->end = map->base + get_bitmap_map_block_index(size_in_bits-1);
+      map->length = size_in_bits;
+   }
+   else {
+      if (end < map->end) {
+         printf("bitmap_grow : request end is lower than old end\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+      if (end == map->end) {
+         printf("bitmap_grow : request end is same as old end\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+      old_end = map->end;
+      old_length = map->length;
+      map->end = end;
+      map->length = (end - map->base + 1) * MAP_BLOCK_BIT;
+   }
+   
+   // the summary and the rank index can not cover the new length
+   if (map->summary != NULL && map->length > map->summary_capacity) {
+      map->summary = NULL;
+      map->summary_capacity = 0;
+   }
+   if (map->rank != NULL && map->length > map->rank_capacity) {
+      map->rank = NULL;
+      map->rank_capacity = 0;
+      map->rank_valid = 0;
+   }
+   
+   // clean off the edge and remaining map blocks
+   mask = s_b_head_mask(get_bitmap_map_block_bit_index(old_length-1) + 1);
+   if (default_value > 1) {
+      ;     // do nothing
+   }
+   else if (default_value & 0x1) {
+      *old_end |= ~mask;
+      for (cur = old_end + 1; cur <= map->end; cur++) {
+         *cur = (map_block) -1;
+      }
+   }
+   else {
+      *old_end &= mask;
+      for (cur = old_end + 1; cur <= map->end; cur++) {
+         *cur = 0;
+      }
+   }
+   
+   bitmap_count_zeros_and_ones(map);
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+// cuts the bitmap and modifies the meta data
+int bitmap_shrink (simple_bitmap* map, map_block* end, uint_fast32_t size_in_bits) {
+   map_block* cur;
+   
+   map_block mask;
+   
+   map_block* old_end;
+   
+   //bit_index old_length;
+   
+   bitmap_meta_decrypt(map);
+   
+   //input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_shrink : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_shrink : base is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->end == NULL) {
+      printf("bitmap_shrink : end is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_shrink : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_shrink : length is inconsistent with base and end\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_shrink : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   #endif
+   
+   if (end == NULL) {
+      #ifndef SIMPLE_BITMAP_SKIP_CHECK
+      if (size_in_bits == 0) {
+         printf("bitmap_shrink : end is NULL but size is 0 as well\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+      if (size_in_bits > map->length) {
+         printf("bitmap_shrink : request length is larger than old length\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+      if (size_in_bits == map->length) {
+         printf("bitmap_shrink : request length is same as old length\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+      #endif
+      old_end = map->end;
+      //old_length = map->length;
+      map->end = map->base + get_bitmap_map_block_index(size_in_bits-1);
+      map->length = size_in_bits;
+   }
+   else {
+      #ifndef SIMPLE_BITMAP_SKIP_CHECK
+      if (end > map->end) {
+         printf("bitmap_shrink : request end is higher than old end\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+      if (end == map->end) {
+         printf("bitmap_shrink : request end is same as old end\n");
+         return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+      }
+      #endif
+      old_end = map->end;
+      //old_length = map->length;
+      map->end = end;
+      map->length = (end - map->base + 1) * MAP_BLOCK_BIT;
+   }
+   
+   // wipe off the edge and old map blocks
+   mask = s_b_head_mask(get_bitmap_map_block_bit_index(map->length-1) + 1);
+   *(map->end) &= mask;
+   for (cur = map->end + 1; cur <= old_end; cur++) {
+      *cur = 0;
+   }
+   
+   bitmap_count_zeros_and_ones(map);
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+// INTERNAL USE, map of gmap must be decrypted
+// makes room for at least capacity_in_bits bits, new map blocks are 0s
+static int map_blocks_growable_reserve (simple_growable_bitmap* gmap, bit_index capacity_in_bits) {
+   simple_bitmap* map = &gmap->map;
+   
+   map_block* base;
+   
+   bit_index old_blocks;
+   bit_index new_blocks;
+   
+   if (capacity_in_bits <= gmap->capacity) {
+      return 0;
+   }
+   
+   old_blocks = gmap->capacity / MAP_BLOCK_BIT;
+   new_blocks = get_bitmap_map_block_number(capacity_in_bits);
+   
+   base = (map_block*) realloc(map->base, sizeof(map_block) * new_blocks);
+   if (base == NULL) {
+      return MEM_ALLOC_FAIL;
+   }
+   
+   memset(base + old_blocks, 0x00, sizeof(map_block) * (new_blocks - old_blocks));
+   
+   map->end = base + (map->end - map->base);
+   map->base = base;
+   
+   gmap->capacity = new_blocks * MAP_BLOCK_BIT;
+   
+   return 0;
+}
+
+int bitmap_growable_init (simple_growable_bitmap* gmap, uint_fast32_t size_in_bits, map_block default_value) {
+   map_block* base;
+   
+   bit_index blocks;
+   
+   int ret;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (gmap == NULL) {
+      printf("bitmap_growable_init : gmap is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (default_value > 1) {
+      printf("bitmap_growable_init : default_value must be 0 or 1\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   // an empty map still gets one map block, so it always has a base
+   blocks = size_in_bits ? get_bitmap_map_block_number(size_in_bits) : 1;
+   
+   base = (map_block*) malloc(sizeof(map_block) * blocks);
+   if (base == NULL) {
+      printf("bitmap_growable_init : failed to allocate map blocks\n");
+      gmap->capacity = 0;
+      return MEM_ALLOC_FAIL;
+   }
+   
+   gmap->capacity = blocks * MAP_BLOCK_BIT;
+   
+   if ((ret = bitmap_init(&gmap->map, base, NULL, size_in_bits ? size_in_bits : 1, size_in_bits ? default_value : 0))) {
+      free(base);
+      gmap->capacity = 0;
+      return ret;
+   }
+   
+   if (size_in_bits == 0) {
+      bitmap_meta_decrypt(&gmap->map);
+      
+      gmap->map.length = 0;
+      gmap->map.number_of_zeros = 0;
+      gmap->map.number_of_ones = 0;
+      
+      bitmap_meta_encrypt(&gmap->map);
+   }
+   
+   return 0;
+}
+
+int bitmap_growable_free (simple_growable_bitmap* gmap) {
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (gmap == NULL) {
+      printf("bitmap_growable_free : gmap is NULL\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   bitmap_meta_decrypt(&gmap->map);
+   
+   free(gmap->map.base);
+   
+   gmap->map.base = NULL;
+   gmap->map.end = NULL;
+   gmap->map.length = 0;
+   gmap->map.number_of_zeros = 0;
+   gmap->map.number_of_ones = 0;
+   gmap->map.summary = NULL;
+   gmap->map.summary_capacity = 0;
+   gmap->map.rank = NULL;
+   gmap->map.rank_capacity = 0;
+   gmap->map.rank_valid = 0;
+   
+   gmap->capacity = 0;
+   
+   bitmap_meta_encrypt(&gmap->map);
+   
+   return 0;
+}
+
+int bitmap_growable_reserve (simple_growable_bitmap* gmap, uint_fast32_t capacity_in_bits) {
+   int ret;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (gmap == NULL) {
+      printf("bitmap_growable_reserve : gmap is NULL\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   bitmap_meta_decrypt(&gmap->map);
+   
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (gmap->map.base == NULL) {
+      printf("bitmap_growable_reserve : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, &gmap->map, NULL, NULL);
+   }
+   #endif
+   
+   ret = map_blocks_growable_reserve(gmap, capacity_in_bits);
+   if (ret) {
+      printf("bitmap_growable_reserve : failed to allocate map blocks\n");
+   }
+   
+   bitmap_meta_encrypt(&gmap->map);
+   
+   return ret;
+}
+
+int bitmap_growable_resize (simple_growable_bitmap* gmap, uint_fast32_t size_in_bits, map_block default_value) {
+   simple_bitmap* map;
+   
+   bit_index old_length;
+   
+   bit_index block;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (gmap == NULL) {
+      printf("bitmap_growable_resize : gmap is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (default_value > 1) {
+      printf("bitmap_growable_resize : default_value must be 0 or 1\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   map = &gmap->map;
+   
+   bitmap_meta_decrypt(map);
+   
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map->base == NULL) {
+      printf("bitmap_growable_resize : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_growable_resize : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   #endif
+   
+   old_length = map->length;
+   
+   if (size_in_bits > gmap->capacity) {
+      if (map_blocks_growable_reserve(gmap, s_b_max(size_in_bits, 2 * gmap->capacity))) {
+         printf("bitmap_growable_resize : failed to allocate map blocks\n");
+         bitmap_meta_encrypt(map);
+         return MEM_ALLOC_FAIL;
+      }
+   }
+   
+   if (size_in_bits > old_length) {
+      // bits beyond the old length are already 0s
+      if (default_value) {
+         map_blocks_fill_bits(map->base, old_length, size_in_bits - old_length, 0x1);
+         map->number_of_ones += size_in_bits - old_length;
+      }
+   }
+   else if (size_in_bits < old_length) {
+      // keep bits beyond the new length as 0s
+      map->number_of_ones -= map_blocks_count_bits(map->base, size_in_bits, old_length - size_in_bits);
+      map_blocks_fill_bits(map->base, size_in_bits, old_length - size_in_bits, 0x0);
+   }
+   
+   map->length = size_in_bits;
+   map->end = map->base + (size_in_bits ? get_bitmap_map_block_index(size_in_bits-1) : 0);
+   map->number_of_zeros = map->length - map->number_of_ones;
+   
+   if (map->summary != NULL) {
+      if (map->length == 0 || map->length > map->summary_capacity) {
+         // the summary can not cover the new length
+         map->summary = NULL;
+         map->summary_capacity = 0;
+      }
+      else if (map->length > old_length) {
+         for (block = get_bitmap_map_block_index(old_length); block <= (bit_index) (map->end - map->base); block++) {
+            map_blocks_summary_update(map, block);
+         }
+      }
+      else if (map->length < old_length) {
+         map_blocks_summary_rebuild(map);
+      }
+   }
+   
+   if (map->rank != NULL && (map->length == 0 || map->length > map->rank_capacity)) {
+      map->rank = NULL;
+      map->rank_capacity = 0;
+      map->rank_valid = 0;
+   }
+   s_b_rank_touch(map, get_bitmap_map_block_index(s_b_min(old_length, size_in_bits)));
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_growable_append (simple_growable_bitmap* gmap, map_block input_value) {
+   simple_bitmap* map;
+   
+   bit_index index;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (gmap == NULL) {
+      printf("bitmap_growable_append : gmap is NULL\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   map = &gmap->map;
+   
+   bitmap_meta_decrypt(map);
+   
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map->base == NULL) {
+      printf("bitmap_growable_append : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   #endif
+   
+   index = map->length;
+   
+   if (index == gmap->capacity) {
+      if (map_blocks_growable_reserve(gmap, 2 * gmap->capacity)) {
+         printf("bitmap_growable_append : failed to allocate map blocks\n");
+         bitmap_meta_encrypt(map);
+         return MEM_ALLOC_FAIL;
+      }
+   }
+   
+   map->length = index + 1;
+   map->end = map->base + get_bitmap_map_block_index(index);
+   
+   // the new bit is already 0
+   if (input_value & 0x1) {
+      s_b_bit_assign(map->base, index, 0x1);
+      map->number_of_ones++;
+   }
+   else {
+      map->number_of_zeros++;
+   }
+   
+   if (map->summary != NULL) {
+      if (map->length > map->summary_capacity) {
+         map->summary = NULL;
+         map->summary_capacity = 0;
+      }
+      else {
+         map_blocks_summary_update(map, get_bitmap_map_block_index(index));
+      }
+   }
+   
+   if (map->rank != NULL && map->length > map->rank_capacity) {
+      map->rank = NULL;
+      map->rank_capacity = 0;
+      map->rank_valid = 0;
+   }
+   s_b_rank_touch(map, get_bitmap_map_block_index(index));
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+#ifdef SIMPLE_BITMAP_MMAP
+// header of the file a map was opened from, map must be decrypted
+#define s_b_file_header(map) ((bitmap_file_header*) ((char*) (map)->base - BITMAP_FILE_HEADER_SIZE))
+
+#define s_b_file_size(size_in_bits) (BITMAP_FILE_HEADER_SIZE + sizeof(map_block) * get_bitmap_map_block_number(size_in_bits))
+
+int bitmap_file_open (simple_bitmap* map, const char* path, uint_fast32_t size_in_bits, map_block default_value) {
+   int fd;
+   
+   struct stat st;
+   
+   void* addr;
+   
+   bitmap_file_header* header;
+   
+   size_t file_size;
+   
+   unsigned char create;
+   
+   unsigned char clean;
+   
+   int ret;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_file_open : map is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (path == NULL) {
+      printf("bitmap_file_open : path is NULL\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   fd = open(path, O_RDWR | O_CREAT, 0644);
+   if (fd < 0) {
+      printf("bitmap_file_open : failed to open file\n");
+      return GENERAL_FAIL;
+   }
+   if (fstat(fd, &st)) {
+      printf("bitmap_file_open : failed to get size of file\n");
+      close(fd);
+      return GENERAL_FAIL;
+   }
+   
+   create = (st.st_size == 0);
+   
+   if (create) {
+      if (size_in_bits == 0) {
+         printf("bitmap_file_open : file is empty but size is 0 as well\n");
+         close(fd);
+         return WRONG_INPUT;
+      }
+      
+      file_size = s_b_file_size(size_in_bits);
+      
+      // the file is extended with 0s
+      if (ftruncate(fd, file_size)) {
+         printf("bitmap_file_open : failed to extend file\n");
+         close(fd);
+         return GENERAL_FAIL;
+      }
+   }
+   else {
+      if ((size_t) st.st_size < BITMAP_FILE_HEADER_SIZE) {
+         printf("bitmap_file_open : file is too small to be a bitmap file\n");
+         close(fd);
+         return CORRUPTED_DATA;
+      }
+      
+      file_size = st.st_size;
+   }
+   
+   addr = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   
+   // the mapping stays valid after the file is closed
+   close(fd);
+   
+   if (addr == MAP_FAILED) {
+      printf("bitmap_file_open : failed to map file\n");
+      return MEM_ALLOC_FAIL;
+   }
+   
+   header = (bitmap_file_header*) addr;
+   
+   if (create) {
+      memcpy(header->magic, BITMAP_FILE_MAGIC, sizeof(header->magic));
+      header->map_block_bit = MAP_BLOCK_BIT;
+      header->clean = 0;
+      header->length = size_in_bits;
+      
+      // all map blocks are 0s already
+      if (default_value == 0) {
+         ret = map_blocks_meta_init(map, (map_block*) ((char*) addr + BITMAP_FILE_HEADER_SIZE), NULL, size_in_bits);
+         if (ret == 0) {
+            bitmap_meta_decrypt(map);
+            map->number_of_zeros = size_in_bits;
+            map->number_of_ones = 0;
+            bitmap_meta_encrypt(map);
+         }
+      }
+      else {
+         ret = bitmap_init(map, (map_block*) ((char*) addr + BITMAP_FILE_HEADER_SIZE), NULL, size_in_bits, default_value);
+      }
+      
+      if (ret) {
+         munmap(addr, file_size);
+         return ret;
+      }
+      
+      return 0;
+   }
+   
+   if (memcmp(header->magic, BITMAP_FILE_MAGIC, sizeof(header->magic)) != 0) {
+      printf("bitmap_file_open : file is not a bitmap file\n");
+      munmap(addr, file_size);
+      return CORRUPTED_DATA;
+   }
+   if (header->map_block_bit != MAP_BLOCK_BIT) {
+      printf("bitmap_file_open : file was created with a different map block size\n");
+      munmap(addr, file_size);
+      return WRONG_INPUT;
+   }
+   if (header->length == 0 || header->length > (bit_index) -1
+         || s_b_file_size(header->length) != file_size) {
+      printf("bitmap_file_open : length in header is inconsistent with size of file\n");
+      munmap(addr, file_size);
+      return CORRUPTED_DATA;
+   }
+   if (size_in_bits != 0 && size_in_bits != header->length) {
+      printf("bitmap_file_open : size is different from length in file\n");
+      munmap(addr, file_size);
+      return WRONG_INPUT;
+   }
+   if (header->clean && header->number_of_ones > header->length) {
+      printf("bitmap_file_open : number of ones in header exceeds length\n");
+      munmap(addr, file_size);
+      return CORRUPTED_DATA;
+   }
+   
+   clean = header->clean;
+   
+   // the counts in the header are stale from now on until the file is closed,
+   // this has to reach the file before any map block can be modified,
+   // otherwise a crash would leave stale counts marked as up to date
+   header->clean = 0;
+   if (msync(header, BITMAP_FILE_HEADER_SIZE, MS_SYNC)) {
+      printf("bitmap_file_open : failed to write back header\n");
+      munmap(addr, file_size);
+      return GENERAL_FAIL;
+   }
+   
+   if ((ret = map_blocks_meta_init(map, (map_block*) ((char*) addr + BITMAP_FILE_HEADER_SIZE), NULL, header->length))) {
+      munmap(addr, file_size);
+      return ret;
+   }
+   
+   if (clean) {
+      // trust the counts, so the map blocks are not read
+      bitmap_meta_decrypt(map);
+      map->number_of_ones = header->number_of_ones;
+      map->number_of_zeros = map->length - map->number_of_ones;
+      bitmap_meta_encrypt(map);
+   }
+   else {
+      bitmap_count_zeros_and_ones(map);
+   }
+   
+   return 0;
+}
+
+int bitmap_file_sync (simple_bitmap* map) {
+   bitmap_file_header* header;
+   
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_file_sync : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_file_sync : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_file_sync : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_file_sync : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   #endif
+   
+   header = s_b_file_header(map);
+   
+   header->number_of_ones = map->number_of_ones;
+   
+   if (msync(header, s_b_file_size(map->length), MS_SYNC)) {
+      printf("bitmap_file_sync : failed to write back file\n");
+      bitmap_meta_encrypt(map);
+      return GENERAL_FAIL;
+   }
+   
+   bitmap_meta_encrypt(map);
+   
+   return 0;
+}
+
+int bitmap_file_close (simple_bitmap* map) {
+   bitmap_file_header* header;
+   
+   int ret = 0;
+   
+   bitmap_meta_decrypt(map);
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_file_close : map is NULL\n");
+      return map_blocks_check_fail(WRONG_INPUT, map, NULL, NULL);
+   }
+   if (map->base == NULL) {
+      printf("bitmap_file_close : base is NULL\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->length == 0) {
+      printf("bitmap_file_close : map has no length\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_file_close : inconsistent statistics of number of ones and zeros\n");
+      return map_blocks_check_fail(CORRUPTED_DATA, map, NULL, NULL);
+   }
+   #endif
+   
+   header = s_b_file_header(map);
+   
+   header->number_of_ones = map->number_of_ones;
+   
+   // write the map blocks back before marking the counts as up to date
+   if (msync(header, s_b_file_size(map->length), MS_SYNC)) {
+      printf("bitmap_file_close : failed to write back file\n");
+      ret = GENERAL_FAIL;
+   }
+   else {
+      header->clean = 1;
+      if (msync(header, BITMAP_FILE_HEADER_SIZE, MS_SYNC)) {
+         printf("bitmap_file_close : failed to write back header\n");
+         ret = GENERAL_FAIL;
+      }
+   }
+   
+   munmap(header, s_b_file_size(map->length));
+   
+   map->base = NULL;
+   map->end = NULL;
+   map->length = 0;
+   map->number_of_zeros = 0;
+   map->number_of_ones = 0;
+   map->summary = NULL;
+   map->summary_capacity = 0;
+   map->rank = NULL;
+   map->rank_capacity = 0;
+   map->rank_valid = 0;
+   
+   bitmap_meta_encrypt(map);
+   
+   return ret;
+}
+#endif
+
+int bitmap_show (simple_bitmap* map) {
+   #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
+   uint_least8_t offsets;
+   uint_least8_t rand_indicators;
+   
+   unsigned char count;
+   #endif
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_show : map is NULL\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   printf("####################\n");
+   
+   printf("map->base : %p\n", map->base);
+   printf("map->end  : %p\n", map->end);
+   printf("map->length : %d\n", (int) map->length);
+   printf("map->number_of_zeros : %d\n", (int) map->number_of_zeros);
+   printf("map->number_of_ones  : %d\n", (int) map->number_of_ones);
+   
+   #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
+   offsets = map->offsets;
+   printf("obj_rand_encrypt_xor_meta  : %x\n", map->obj_rand_encrypt_xor_meta);
+   printf("obj_rand_encrypt_add_meta  : %x\n", map->obj_rand_encrypt_add_meta);
+   printf("obj_rand_encrypt_xor_meta2 : %x\n", map->obj_rand_encrypt_xor_meta2);
+   printf("obj_rand_encrypt_add_meta2 : %x\n", map->obj_rand_encrypt_add_meta2);
+   printf("* - actually used\n");
+   printf("offsets : %x\n", offsets);
+   if (!((offsets >> OFF_BA)&0x1)) {
+      printf("map->base[0]* : %p\n", map->base_a[0]);
+      printf("map->base[1]  : %p\n", map->base_a[1]);
+   }
+   else {
+      printf("map->base[0]  : %p\n", map->base_a[0]);
+      printf("map->base[1]* : %p\n", map->base_a[1]);
+   }
+   if (!((offsets >> OFF_EN)&0x1)) {
+      printf("map->end[0]*  : %p\n", map->end_a[0]);
+      printf("map->end[1]   : %p\n", map->end_a[1]);
+   }
+   else {
+      printf("map->end[0]   : %p\n", map->end_a[0]);
+      printf("map->end[1]*  : %p\n", map->end_a[1]);
+   }
+   if (!((offsets >> OFF_LE)&0x1)) {
+      printf("map->length[0]* : %u\n", map->length_a[0]);
+      printf("map->length[1]  : %u\n", map->length_a[1]);
+   }
+   else {
+      printf("map->length[0]  : %u\n", map->length_a[0]);
+      printf("map->length[1]* : %u\n", map->length_a[1]);
+   }
+   if (!((offsets >> OFF_NZ)&0x1)) {
+      printf("map->number_of_zeros[0]* : %u\n", map->number_of_zeros_a[0]);
+      printf("map->number_of_zeros[1]  : %u\n", map->number_of_zeros_a[1]);
+   }
+   else {
+      printf("map->number_of_zeros[0]  : %u\n", map->number_of_zeros_a[0]);
+      printf("map->number_of_zeros[1]* : %u\n", map->number_of_zeros_a[1]);
+   }
+   if (!((offsets >> OFF_NO)&0x1)) {
+      printf("map->number_of_ones[0]*  : %u\n", map->number_of_ones_a[0]);
+      printf("map->number_of_ones[1]   : %u\n", map->number_of_ones_a[1]);
+   }
+   else {
+      printf("map->number_of_ones[0]   : %u\n", map->number_of_ones_a[0]);
+      printf("map->number_of_ones[1]*  : %u\n", map->number_of_ones_a[1]);
+   }
+   
+   rand_indicators = map->rand_indicators;
+   
+   printf("map->rand_indicators : %x\n", rand_indicators);
+   printf("map->rand_degrees :\n");
+   for (count = 0; count < 5; count++) {
+      printf("   [%d][%d] : %d, ", count, 0, map->rand_degrees[count][0]);
+      printf("   [%d][%d] : %d\n", count, 1, map->rand_degrees[count][1]);
+   }
+   
+   /*printf("map->rand_revert_to : ");
+   for (count = 0; count < sizeof(map->rand_revert_to)-1; count++) {
+      printf("%x, ", map->rand_revert_to[count]);
+   }
+   printf("%x\n", map->rand_revert_to[count]);*/
+   #endif
+   
+   printf("####################\n");
+   
+   return 0;
+}
+
+int bitmap_cont_group_show (bitmap_cont_group* grp) {
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (grp == NULL) {
+      printf("bitmap_cont_group_show : grp is NULL\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   printf("####################\n");
+   
+   printf("grp->bit_type : %x\n", (unsigned int) grp->bit_type);
+   printf("grp->start  : %d\n", (int) grp->start);
+   printf("grp->length : %d\n", (int) grp->length);
+   
+   printf("####################\n");
+   
+   return 0;
+}
+
+int bitmap_raw_show (simple_bitmap* map) {
+   uint_fast16_t count;
+   
+   map_block* cur;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_raw_show : map is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (map->base == NULL) {
+      printf("bitmap_raw_show : base is NULL\n");
+      return CORRUPTED_DATA;
+   }
+   if (map->end == NULL) {
+      printf("bitmap_raw_show : end is NULL\n");
+      return CORRUPTED_DATA;
+   }
+   if (map->length == 0) {
+      printf("bitmap_raw_show : map has no length\n");
+      return CORRUPTED_DATA;
+   }
+   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
+      printf("bitmap_raw_show : length is inconsistent with base and end\n");
+      return CORRUPTED_DATA;
+   }
+   if (map->number_of_zeros + map->number_of_ones != map->length) {
+      printf("bitmap_raw_show : inconsistent statistics of number of ones and zeros\n");
+      return CORRUPTED_DATA;
+   }
+   #endif
+   printf("####################\n");
+   
+   printf("bitmap_raw :\n");
+   
+   count = 0;
+   for (cur = map->base; cur <= map->end; cur++) {
+      printf("%0*llX ", (int) (MAP_BLOCK_BIT / 4), (unsigned long long) *cur);
+      if (count == 15) {
+         count = 0;
+         printf("\n");
+      }
+      else {
+         count++;
+      }
+   }
+   printf("\n");
+   
+   printf("####################\n");
+   
+   return 0;
+}
+#define S_B_SPARSE_ARRAY_MAX     4096     // an array container of this many values is as large as a bitset
+#define S_B_SPARSE_RUN_MAX       2048     // same for a run container
+#define S_B_SPARSE_BITSET_WORDS  (BITMAP_SPARSE_CHUNK_BIT / 64)
+#define S_B_SPARSE_BITSET_BYTES  (BITMAP_SPARSE_CHUNK_BIT / CHAR_BIT)
+
+// number of bits covered by chunk k, only the last chunk may be shorter
+#define s_b_sparse_chunk_bits(map, k) \
+   ((k) == (map)->chunk_number - 1 ? (map)->length - (k) * BITMAP_SPARSE_CHUNK_BIT : BITMAP_SPARSE_CHUNK_BIT)
+
+// INTERNAL USE
+static void map_blocks_sparse_clear (bitmap_sparse_container* c) {
+   free(c->data.values);
+   
+   c->type = BITMAP_SPARSE_EMPTY;
+   c->cardinality = 0;
+   c->size = 0;
+   c->capacity = 0;
+   c->data.values = NULL;
+}
+
+// INTERNAL USE
+// makes room for at least capacity entries of entry_size bytes, growing by doubling up to limit
+static int map_blocks_sparse_reserve (bitmap_sparse_container* c, uint_fast32_t capacity, size_t entry_size, uint_fast32_t limit) {
+   uint_fast32_t new_capacity;
+   
+   uint16_t* new_data;
+   
+   if (capacity <= c->capacity) {
+      return 0;
+   }
+   
+   new_capacity = c->capacity < 4 ? 4 : c->capacity * 2;
+   new_capacity = s_b_max(new_capacity, capacity);
+   new_capacity = s_b_min(new_capacity, limit);
+   
+   new_data = (uint16_t*) realloc(c->data.values, entry_size * new_capacity);
+   if (new_data == NULL) {
+      return MEM_ALLOC_FAIL;
+   }
+   
+   c->data.values = new_data;
+   c->capacity = new_capacity;
+   
+   return 0;
+}
+
+// INTERNAL USE
+// returns index of the first value not less than v, or size if there is none
+static uint_fast32_t map_blocks_sparse_lower_bound (uint16_t* values, uint_fast32_t size, uint_fast32_t v) {
+   uint_fast32_t base = 0;
+   uint_fast32_t half;
+   
+   if (size == 0) {
+      return 0;
+   }
+   
+   // written without branches on the comparison, which are hardly ever predicted right
+   while (size > 1) {
+      half = size / 2;
+      base = values[base + half] < v ? base + half : base;
+      size -= half;
+   }
+   
+   return base + (values[base] < v);
+}
+
+// INTERNAL USE
+// returns index of the first run ending at or after v, or size if there is none
+static uint_fast32_t map_blocks_sparse_run_find (uint16_t* runs, uint_fast32_t size, uint_fast32_t v) {
+   uint_fast32_t base = 0;
+   uint_fast32_t half;
+   
+   if (size == 0) {
+      return 0;
+   }
+   
+   // same as map_blocks_sparse_lower_bound, on the last offsets of the runs
+   while (size > 1) {
+      half = size / 2;
+      base = runs[2 * (base + half) + 1] < v ? base + half : base;
+      size -= half;
+   }
+   
+   return base + (runs[2 * base + 1] < v);
+}
+
+// INTERNAL USE
+// sets or clears bits first to last of a bitset, both inclusive
+static void map_blocks_sparse_words_assign (uint64_t* words, uint_fast32_t first, uint_fast32_t last, map_block value) {
+   uint_fast32_t w;
+   
+   uint64_t mask;
+   
+   for (w = first / 64; w <= last / 64; w++) {
+      mask = ~(uint64_t) 0;
+      if (w == first / 64) {
+         mask &= ~(uint64_t) 0 << (first % 64);
+      }
+      if (w == last / 64) {
+         mask &= ~(uint64_t) 0 >> (63 - last % 64);
+      }
+      
+      if (value & 0x1) {
+         words[w] |= mask;
+      }
+      else {
+         words[w] &= ~mask;
+      }
+   }
+}
+
+// INTERNAL USE
+static map_block map_blocks_sparse_test (bitmap_sparse_container* c, uint_fast32_t v) {
+   uint_fast32_t i;
+   
+   switch (c->type) {
+      case BITMAP_SPARSE_ARRAY :
+         i = map_blocks_sparse_lower_bound(c->data.values, c->size, v);
+         return i < c->size && c->data.values[i] == v;
+      case BITMAP_SPARSE_BITSET :
+         return (c->data.words[v / 64] >> (v % 64)) & 0x1;
+      case BITMAP_SPARSE_RUN :
+         i = map_blocks_sparse_run_find(c->data.runs, c->size, v);
+         return i < c->size && c->data.runs[2 * i] <= v;
+      default :
+         return 0;
+   }
+}
+
+// INTERNAL USE
+// converts any container into a bitset
+static int map_blocks_sparse_to_bitset (bitmap_sparse_container* c) {
+   uint64_t* words;
+   
+   uint_fast32_t i;
+   
+   if (c->type == BITMAP_SPARSE_BITSET) {
+      return 0;
+   }
+   
+   words = (uint64_t*) calloc(S_B_SPARSE_BITSET_WORDS, sizeof(uint64_t));
+   if (words == NULL) {
+      return MEM_ALLOC_FAIL;
+   }
+   
+   if (c->type == BITMAP_SPARSE_ARRAY) {
+      for (i = 0; i < c->size; i++) {
+         words[c->data.values[i] / 64] |= (uint64_t) 0x1 << (c->data.values[i] % 64);
+      }
+   }
+   else if (c->type == BITMAP_SPARSE_RUN) {
+      for (i = 0; i < c->size; i++) {
+         map_blocks_sparse_words_assign(words, c->data.runs[2 * i], c->data.runs[2 * i + 1], 1);
+      }
+   }
+   
+   free(c->data.values);
+   
+   c->type = BITMAP_SPARSE_BITSET;
+   c->size = 0;
+   c->capacity = 0;
+   c->data.words = words;
+   
+   return 0;
+}
+
+// INTERNAL USE
+// recounts a bitset and switches it to an array or run container if either is smaller
+static int map_blocks_sparse_optimise (bitmap_sparse_container* c) {
+   uint64_t* words = c->data.words;
+   
+   uint64_t word;
+   uint64_t starts;
+   
+   uint_fast32_t card = 0;
+   uint_fast32_t runs = 0;
+   uint_fast32_t w;
+   uint_fast32_t v;
+   uint_fast32_t n;
+   
+   size_t array_bytes;
+   size_t run_bytes;
+   
+   uint16_t* data;
+   
+   uint64_t carry = 0;   // whether the last bit of the previous word is set
+   
+   for (w = 0; w < S_B_SPARSE_BITSET_WORDS; w++) {
+      card += s_b_popcount64(words[w]);
+      
+      // a run starts wherever a set bit follows an unset one
+      runs += s_b_popcount64(words[w] & ~((words[w] << 1) | carry));
+      carry = words[w] >> 63;
+   }
+   
+   c->cardinality = card;
+   
+   if (card == 0) {
+      map_blocks_sparse_clear(c);
+      return 0;
+   }
+   
+   array_bytes = card <= S_B_SPARSE_ARRAY_MAX ? card * sizeof(uint16_t) : S_B_SPARSE_BITSET_BYTES;
+   run_bytes = runs * 2 * sizeof(uint16_t);
+   
+   // runs < S_B_SPARSE_RUN_MAX follows from the last condition
+   if (run_bytes < array_bytes && run_bytes < S_B_SPARSE_BITSET_BYTES) {
+      data = (uint16_t*) malloc(run_bytes);
+      if (data == NULL) {
+         return 0;   // stays a bitset, which is still correct
+      }
+      
+      n = 0;
+      v = 0;
+      while (v < BITMAP_SPARSE_CHUNK_BIT) {
+         // start of the next run
+         w = v / 64;
+         word = words[w] & (~(uint64_t) 0 << (v % 64));
+         while (word == 0 && ++w < S_B_SPARSE_BITSET_WORDS) {
+            word = words[w];
+         }
+         if (word == 0) {
+            break;
+         }
+         v = w * 64 + s_b_ctz64(word);
+         data[2 * n] = v;
+         
+         // end of the run
+         word = ~words[w] & (~(uint64_t) 0 << (v % 64));
+         while (word == 0 && ++w < S_B_SPARSE_BITSET_WORDS) {
+            word = ~words[w];
+         }
+         v = word == 0 ? BITMAP_SPARSE_CHUNK_BIT : w * 64 + s_b_ctz64(word);
+         data[2 * n + 1] = v - 1;
+         
+         n++;
+      }
+      
+      free(words);
+      
+      c->type = BITMAP_SPARSE_RUN;
+      c->size = n;
+      c->capacity = n;
+      c->data.runs = data;
+   }
+   else if (array_bytes < S_B_SPARSE_BITSET_BYTES) {
+      data = (uint16_t*) malloc(array_bytes);
+      if (data == NULL) {
+         return 0;
+      }
+      
+      n = 0;
+      for (w = 0; w < S_B_SPARSE_BITSET_WORDS; w++) {
+         for (starts = words[w]; starts; starts &= starts - 1) {
+            data[n++] = w * 64 + s_b_ctz64(starts);
+         }
+      }
+      
+      free(words);
+      
+      c->type = BITMAP_SPARSE_ARRAY;
+      c->size = n;
+      c->capacity = n;
+      c->data.values = data;
+   }
+   
+   return 0;
+}
+
+// INTERNAL USE
+// returns 1 if the bit was 0, 0 if it was already 1, or MEM_ALLOC_FAIL
+static int map_blocks_sparse_set (bitmap_sparse_container* c, uint_fast32_t v) {
+   uint16_t* runs;
+   
+   uint_fast32_t i;
+   
+   int join_prev;
+   int join_next;
+   
+   switch (c->type) {
+      case BITMAP_SPARSE_EMPTY :
+         if (map_blocks_sparse_reserve(c, 1, sizeof(uint16_t), S_B_SPARSE_ARRAY_MAX) != 0) {
+            return MEM_ALLOC_FAIL;
+         }
+         c->type = BITMAP_SPARSE_ARRAY;
+         c->data.values[0] = v;
+         c->size = 1;
+         c->cardinality = 1;
+         return 1;
+      case BITMAP_SPARSE_ARRAY :
+         i = map_blocks_sparse_lower_bound(c->data.values, c->size, v);
+         if (i < c->size && c->data.values[i] == v) {
+            return 0;
+         }
+         if (c->size < S_B_SPARSE_ARRAY_MAX) {
+            if (map_blocks_sparse_reserve(c, c->size + 1, sizeof(uint16_t), S_B_SPARSE_ARRAY_MAX) != 0) {
+               return MEM_ALLOC_FAIL;
+            }
+            memmove(c->data.values + i + 1, c->data.values + i, sizeof(uint16_t) * (c->size - i));
+            c->data.values[i] = v;
+            c->size++;
+            c->cardinality++;
+            return 1;
+         }
+         // full, becomes a bitset
+         if (map_blocks_sparse_to_bitset(c) != 0) {
+            return MEM_ALLOC_FAIL;
+         }
+         break;
+      case BITMAP_SPARSE_RUN :
+         runs = c->data.runs;
+         i = map_blocks_sparse_run_find(runs, c->size, v);
+         if (i < c->size && runs[2 * i] <= v) {
+            return 0;
+         }
+         
+         // v is now between run i-1 and run i
+         join_prev = i > 0 && (uint_fast32_t) runs[2 * i - 1] + 1 == v;
+         join_next = i < c->size && (uint_fast32_t) runs[2 * i] == v + 1;
+         
+         if (join_prev && join_next) {
+            runs[2 * i - 1] = runs[2 * i + 1];
+            memmove(runs + 2 * i, runs + 2 * i + 2, 2 * sizeof(uint16_t) * (c->size - i - 1));
+            c->size--;
+         }
+         else if (join_prev) {
+            runs[2 * i - 1] = v;
+         }
+         else if (join_next) {
+            runs[2 * i] = v;
+         }
+         else {
+            // runs of single bits are better off in an array or a bitset
+            if ((c->size + 1) * 2 > c->cardinality + 1 || c->size == S_B_SPARSE_RUN_MAX) {
+               if (map_blocks_sparse_to_bitset(c) != 0) {
+                  return MEM_ALLOC_FAIL;
+               }
+               c->data.words[v / 64] |= (uint64_t) 0x1 << (v % 64);
+               c->cardinality++;
+               map_blocks_sparse_optimise(c);
+               return 1;
+            }
+            if (map_blocks_sparse_reserve(c, c->size + 1, 2 * sizeof(uint16_t), S_B_SPARSE_RUN_MAX) != 0) {
+               return MEM_ALLOC_FAIL;
+            }
+            runs = c->data.runs;
+            memmove(runs + 2 * i + 2, runs + 2 * i, 2 * sizeof(uint16_t) * (c->size - i));
+            runs[2 * i] = v;
+            runs[2 * i + 1] = v;
+            c->size++;
+         }
+         c->cardinality++;
+         return 1;
+   }
+   
+   // bitset
+   if ((c->data.words[v / 64] >> (v % 64)) & 0x1) {
+      return 0;
+   }
+   c->data.words[v / 64] |= (uint64_t) 0x1 << (v % 64);
+   c->cardinality++;
+   
+   return 1;
+}
+
+// INTERNAL USE
+// returns 1 if the bit was 1, 0 if it was already 0, or MEM_ALLOC_FAIL
+static int map_blocks_sparse_unset (bitmap_sparse_container* c, uint_fast32_t v) {
+   uint16_t* runs;
+   
+   uint_fast32_t i;
+   
+   switch (c->type) {
+      case BITMAP_SPARSE_ARRAY :
+         i = map_blocks_sparse_lower_bound(c->data.values, c->size, v);
+         if (i == c->size || c->data.values[i] != v) {
+            return 0;
+         }
+         memmove(c->data.values + i, c->data.values + i + 1, sizeof(uint16_t) * (c->size - i - 1));
+         c->size--;
+         c->cardinality--;
+         break;
+      case BITMAP_SPARSE_BITSET :
+         if (!((c->data.words[v / 64] >> (v % 64)) & 0x1)) {
+            return 0;
+         }
+         c->data.words[v / 64] &= ~((uint64_t) 0x1 << (v % 64));
+         c->cardinality--;
+         // switch back only well below the array limit, so that a map hovering around it
+         // does not convert on every write
+         if (c->cardinality <= S_B_SPARSE_ARRAY_MAX / 2) {
+            map_blocks_sparse_optimise(c);
+         }
+         return 1;
+      case BITMAP_SPARSE_RUN :
+         runs = c->data.runs;
+         i = map_blocks_sparse_run_find(runs, c->size, v);
+         if (i == c->size || runs[2 * i] > v) {
+            return 0;
+         }
+         if (runs[2 * i] == runs[2 * i + 1]) {
+            memmove(runs + 2 * i, runs + 2 * i + 2, 2 * sizeof(uint16_t) * (c->size - i - 1));
+            c->size--;
+         }
+         else if (runs[2 * i] == v) {
+            runs[2 * i]++;
+         }
+         else if (runs[2 * i + 1] == v) {
+            runs[2 * i + 1]--;
+         }
+         else {
+            // split the run in two
+            if (c->size == S_B_SPARSE_RUN_MAX) {
+               if (map_blocks_sparse_to_bitset(c) != 0) {
+                  return MEM_ALLOC_FAIL;
+               }
+               return map_blocks_sparse_unset(c, v);
+            }
+            if (map_blocks_sparse_reserve(c, c->size + 1, 2 * sizeof(uint16_t), S_B_SPARSE_RUN_MAX) != 0) {
+               return MEM_ALLOC_FAIL;
+            }
+            runs = c->data.runs;
+            memmove(runs + 2 * i + 2, runs + 2 * i, 2 * sizeof(uint16_t) * (c->size - i));
+            runs[2 * i + 1] = v - 1;
+            runs[2 * i + 2] = v + 1;
+            c->size++;
+         }
+         c->cardinality--;
+         break;
+      default :
+         return 0;
+   }
+   
+   if (c->cardinality == 0) {
+      map_blocks_sparse_clear(c);
+   }
+   
+   return 1;
+}
+
+// INTERNAL USE
+// assigns value to bits first to last of a container covering chunk_bits bits
+static int map_blocks_sparse_assign_range (bitmap_sparse_container* c, uint_fast32_t first, uint_fast32_t last, map_block value, uint_fast32_t chunk_bits) {
+   uint16_t* runs;
+   
+   // the whole chunk
+   if (first == 0 && last == chunk_bits - 1) {
+      if (value & 0x1) {
+         runs = (uint16_t*) malloc(2 * sizeof(uint16_t));
+         if (runs == NULL) {
+            return MEM_ALLOC_FAIL;
+         }
+         map_blocks_sparse_clear(c);
+         runs[0] = 0;
+         runs[1] = chunk_bits - 1;
+         c->type = BITMAP_SPARSE_RUN;
+         c->cardinality = chunk_bits;
+         c->size = 1;
+         c->capacity = 1;
+         c->data.runs = runs;
+      }
+      else {
+         map_blocks_sparse_clear(c);
+      }
+      return 0;
+   }
+   
+   if (c->type == BITMAP_SPARSE_EMPTY && !(value & 0x1)) {
+      return 0;
+   }
+   
+   // part of the chunk, done on a bitset then compressed again
+   if (map_blocks_sparse_to_bitset(c) != 0) {
+      return MEM_ALLOC_FAIL;
+   }
+   map_blocks_sparse_words_assign(c->data.words, first, last, value);
+   
+   return map_blocks_sparse_optimise(c);
+}
+
+// INTERNAL USE
+// returns the first offset at or after v holding a bit of bit_type, or BITMAP_SPARSE_CHUNK_BIT if there is none
+static uint_fast32_t map_blocks_sparse_next (bitmap_sparse_container* c, uint_fast32_t v, map_block bit_type) {
+   uint64_t flip = bit_type ? 0 : ~(uint64_t) 0;
+   uint64_t word;
+   
+   uint_fast32_t w;
+   uint_fast32_t i;
+   
+   switch (c->type) {
+      case BITMAP_SPARSE_ARRAY :
+         i = map_blocks_sparse_lower_bound(c->data.values, c->size, v);
+         if (bit_type) {
+            return i < c->size ? c->data.values[i] : BITMAP_SPARSE_CHUNK_BIT;
+         }
+         for (; i < c->size && c->data.values[i] == v; i++) {
+            v++;
+         }
+         return v;
+      case BITMAP_SPARSE_BITSET :
+         w = v / 64;
+         word = (c->data.words[w] ^ flip) & (~(uint64_t) 0 << (v % 64));
+         while (word == 0 && ++w < S_B_SPARSE_BITSET_WORDS) {
+            word = c->data.words[w] ^ flip;
+         }
+         return word == 0 ? BITMAP_SPARSE_CHUNK_BIT : w * 64 + s_b_ctz64(word);
+      case BITMAP_SPARSE_RUN :
+         i = map_blocks_sparse_run_find(c->data.runs, c->size, v);
+         if (bit_type) {
+            return i < c->size ? s_b_max(c->data.runs[2 * i], v) : BITMAP_SPARSE_CHUNK_BIT;
+         }
+         // runs never touch, so the bit after a run is always 0
+         return i < c->size && c->data.runs[2 * i] <= v ? (uint_fast32_t) c->data.runs[2 * i + 1] + 1 : v;
+      default :
+         return bit_type ? BITMAP_SPARSE_CHUNK_BIT : v;
+   }
+}
+
+// INTERNAL USE, map must be checked
+// returns index of the first bit equal to bit_type at or after from,
+// or map->length if there is none
+static bit_index map_blocks_sparse_find_bit_fwd (simple_sparse_bitmap* map, bit_index from, map_block bit_type) {
+   bit_index k;
+   
+   uint_fast32_t v;
+   
+   for (k = from / BITMAP_SPARSE_CHUNK_BIT; k < map->chunk_number; k++) {
+      v = map_blocks_sparse_next(map->chunks + k, k == from / BITMAP_SPARSE_CHUNK_BIT ? from % BITMAP_SPARSE_CHUNK_BIT : 0, bit_type);
+      if (v < s_b_sparse_chunk_bits(map, k)) {
+         return k * BITMAP_SPARSE_CHUNK_BIT + v;
+      }
+   }
+   
+   return map->length;
+}
+
+int bitmap_sparse_init (simple_sparse_bitmap* map, uint_fast32_t size_in_bits, map_block default_value) {
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_sparse_init : map is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (size_in_bits == 0) {
+      printf("bitmap_sparse_init : size_in_bits is 0\n");
+      return WRONG_INPUT;
+   }
+   if (default_value > 1) {
+      printf("bitmap_sparse_init : default_value must be 0 or 1\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   map->chunk_number = size_in_bits / BITMAP_SPARSE_CHUNK_BIT + (size_in_bits % BITMAP_SPARSE_CHUNK_BIT == 0 ? 0 : 1);
+   
+   // all zero containers are empty
+   map->chunks = (bitmap_sparse_container*) calloc(map->chunk_number, sizeof(bitmap_sparse_container));
+   if (map->chunks == NULL) {
+      printf("bitmap_sparse_init : failed to allocate containers\n");
+      map->length = 0;
+      return MEM_ALLOC_FAIL;
+   }
+   
+   map->length = size_in_bits;
+   map->number_of_zeros = size_in_bits;
+   map->number_of_ones = 0;
+   
+   if (default_value == 1) {
+      return bitmap_sparse_one(map);
+   }
+   
+   return 0;
+}
+
+int bitmap_sparse_free (simple_sparse_bitmap* map) {
+   bit_index k;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_sparse_free : map is NULL\n");
+      return WRONG_INPUT;
+   }
+   #endif
+   
+   if (map->chunks != NULL) {
+      for (k = 0; k < map->chunk_number; k++) {
+         map_blocks_sparse_clear(map->chunks + k);
+      }
+      free(map->chunks);
+   }
+   
+   map->chunks = NULL;
+   map->chunk_number = 0;
+   map->length = 0;
+   map->number_of_zeros = 0;
+   map->number_of_ones = 0;
+   
+   return 0;
+}
+
+int bitmap_sparse_zero (simple_sparse_bitmap* map) {
+   bit_index k;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_sparse_zero : map is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (map->chunks == NULL) {
+      printf("bitmap_sparse_zero : map is not initialised\n");
+      return CORRUPTED_DATA;
+   }
+   #endif
+   
+   for (k = 0; k < map->chunk_number; k++) {
+      map_blocks_sparse_clear(map->chunks + k);
+   }
+   
+   map->number_of_zeros = map->length;
+   map->number_of_ones = 0;
+   
+   return 0;
+}
+
+int bitmap_sparse_one (simple_sparse_bitmap* map) {
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_sparse_one : map is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (map->chunks == NULL) {
+      printf("bitmap_sparse_one : map is not initialised\n");
+      return CORRUPTED_DATA;
+   }
+   #endif
+   
+   return bitmap_sparse_write_range(map, 0, map->length - 1, 1);
+}
+
+map_block bitmap_sparse_test (simple_sparse_bitmap* map, bit_index index) {
+   return map_blocks_sparse_test(map->chunks + index / BITMAP_SPARSE_CHUNK_BIT, index % BITMAP_SPARSE_CHUNK_BIT);
+}
+
+int bitmap_sparse_read (simple_sparse_bitmap* map, bit_index index, map_block* result) {
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_sparse_read : map is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (map->chunks == NULL) {
+      printf("bitmap_sparse_read : map is not initialised\n");
+      return CORRUPTED_DATA;
+   }
+   if (result == NULL) {
+      printf("bitmap_sparse_read : result is NULL\n");
+      return WRONG_INPUT;
    }
+   if (index >= map->length) {
+      printf("bitmap_sparse_read : index out of range\n");
+      return WRONG_INPUT;
+   }
+   #endif
    
-   bitmap_count_zeros_and_ones(map);
-   
-   bitmap_meta_encrypt(map);
+   *result = bitmap_sparse_test(map, index);
    
    return 0;
 }
 
-// cuts the bitmap and modifies the meta data
-int bitmap_shrink (simple_bitmap* map, map_block* end, uint_fast32_t size_in_bits) {
-   map_block* cur;
-   
-   map_block mask;
-   
-   map_block* old_end;
-   
-   //bit_index old_length;
-   
-   unsigned char count;
-   
-   bitmap_meta_decrypt(map);
+int bitmap_sparse_write (simple_sparse_bitmap* map, bit_index index, map_block input_value) {
+   int ret;
    
-   //input check
+   // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
    if (map == NULL) {
-      printf("bitmap_shrink : map is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map->base == NULL) {
-      printf("bitmap_shrink : base is NULL\n");
-      return WRONG_INPUT;
-   }
-   if (map->end == NULL) {
-      printf("bitmap_shrink : end is NULL\n");
+      printf("bitmap_sparse_write : map is NULL\n");
       return WRONG_INPUT;
    }
-   if (map->length == 0) {
-      printf("bitmap_shrink : map has no length\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_shrink : length is inconsistent with base and end\n");
+   if (map->chunks == NULL) {
+      printf("bitmap_sparse_write : map is not initialised\n");
       return CORRUPTED_DATA;
    }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_shrink : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (index >= map->length) {
+      printf("bitmap_sparse_write : index out of range\n");
+      return WRONG_INPUT;
    }
    #endif
    
-   if (end == NULL) {
-      #ifndef SIMPLE_BITMAP_SKIP_CHECK
-      if (size_in_bits == 0) {
-         printf("bitmap_shrink : end is NULL but size is 0 as well\n");
-         return WRONG_INPUT;
-      }
-      if (size_in_bits > map->length) {
-         printf("bitmap_shrink : request length is larger than old length\n");
-         return WRONG_INPUT;
-      }
-      if (size_in_bits == map->length) {
-         printf("bitmap_shrink : request length is same as old length\n");
-         return WRONG_INPUT;
-      }
-      #endif
-      old_end = map->end;
-      //old_length = map->length;
-      map->end = map->base + get_bitmap_map_block_index(size_in_bits-1);
-      map->length = size_in_bits;
+   if (input_value & 0x1) {
+      ret = map_blocks_sparse_set(map->chunks + index / BITMAP_SPARSE_CHUNK_BIT, index % BITMAP_SPARSE_CHUNK_BIT);
    }
    else {
-      #ifndef SIMPLE_BITMAP_SKIP_CHECK
-      if (end > map->end) {
-         printf("bitmap_shrink : request end is higher than old end\n");
-         return WRONG_INPUT;
-      }
-      if (end == map->end) {
-         printf("bitmap_shrink : request end is same as old end\n");
-         return WRONG_INPUT;
-      }
-      #endif
-      old_end = map->end;
-      //old_length = map->length;
-      map->end = end;
-      map->length = (end - map->base + 1) * MAP_BLOCK_BIT;
+      ret = map_blocks_sparse_unset(map->chunks + index / BITMAP_SPARSE_CHUNK_BIT, index % BITMAP_SPARSE_CHUNK_BIT);
    }
    
-   // wipe off the edge and old map blocks
-   mask = 0;
-   for (count = 0; count <= get_bitmap_map_block_bit_index(map->length-1); count++) {
-      mask |= 0x1 << (MAP_BLOCK_BIT - count - 1);
-   }
-   *(map->end) &= mask;
-   for (cur = map->end + 1; cur <= old_end; cur++) {
-      *cur = 0;
+   if (ret == MEM_ALLOC_FAIL) {
+      printf("bitmap_sparse_write : failed to allocate container\n");
+      return MEM_ALLOC_FAIL;
    }
    
-   bitmap_count_zeros_and_ones(map);
-   
-   bitmap_meta_encrypt(map);
+   // bit changed
+   if (ret == 1) {
+      if (input_value & 0x1) {
+         map->number_of_zeros    --;
+         map->number_of_ones     ++;
+      }
+      else {
+         map->number_of_zeros    ++;
+         map->number_of_ones     --;
+      }
+   }
    
    return 0;
 }
 
-int bitmap_show (simple_bitmap* map) {
-   #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
-   uint_least8_t offsets;
-   uint_least8_t rand_indicators;
+int bitmap_sparse_write_range (simple_sparse_bitmap* map, bit_index from, bit_index to, map_block input_value) {
+   bitmap_sparse_container* c;
    
-   unsigned char count;
-   #endif
+   bit_index k;
+   
+   uint_fast32_t first;
+   uint_fast32_t last;
+   uint_fast32_t old_card;
+   
+   int ret = 0;
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
    if (map == NULL) {
-      printf("bitmap_show : map is NULL\n");
+      printf("bitmap_sparse_write_range : map is NULL\n");
       return WRONG_INPUT;
    }
-   #endif
-   printf("####################\n");
-   
-   printf("map->base : %p\n", map->base);
-   printf("map->end  : %p\n", map->end);
-   printf("map->length : %d\n", (int) map->length);
-   printf("map->number_of_zeros : %d\n", (int) map->number_of_zeros);
-   printf("map->number_of_ones  : %d\n", (int) map->number_of_ones);
-   
-   #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
-   offsets = map->offsets;
-   printf("obj_rand_encrypt_xor_meta  : %x\n", map->obj_rand_encrypt_xor_meta);
-   printf("obj_rand_encrypt_add_meta  : %x\n", map->obj_rand_encrypt_add_meta);
-   printf("obj_rand_encrypt_xor_meta2 : %x\n", map->obj_rand_encrypt_xor_meta2);
-   printf("obj_rand_encrypt_add_meta2 : %x\n", map->obj_rand_encrypt_add_meta2);
-   printf("* - actually used\n");
-   printf("offsets : %x\n", offsets);
-   if (!((offsets >> OFF_BA)&0x1)) {
-      printf("map->base[0]* : %p\n", map->base_a[0]);
-      printf("map->base[1]  : %p\n", map->base_a[1]);
-   }
-   else {
-      printf("map->base[0]  : %p\n", map->base_a[0]);
-      printf("map->base[1]* : %p\n", map->base_a[1]);
-   }
-   if (!((offsets >> OFF_EN)&0x1)) {
-      printf("map->end[0]*  : %p\n", map->end_a[0]);
-      printf("map->end[1]   : %p\n", map->end_a[1]);
+   if (map->chunks == NULL) {
+      printf("bitmap_sparse_write_range : map is not initialised\n");
+      return CORRUPTED_DATA;
    }
-   else {
-      printf("map->end[0]   : %p\n", map->end_a[0]);
-      printf("map->end[1]*  : %p\n", map->end_a[1]);
+   if (from > to) {
+      printf("bitmap_sparse_write_range : from is larger than to\n");
+      return WRONG_INPUT;
    }
-   if (!((offsets >> OFF_LE)&0x1)) {
-      printf("map->length[0]* : %u\n", map->length_a[0]);
-      printf("map->length[1]  : %u\n", map->length_a[1]);
+   if (to >= map->length) {
+      printf("bitmap_sparse_write_range : to is out of range\n");
+      return WRONG_INPUT;
    }
-   else {
-      printf("map->length[0]  : %u\n", map->length_a[0]);
-      printf("map->length[1]* : %u\n", map->length_a[1]);
+   #endif
+   
+   for (k = from / BITMAP_SPARSE_CHUNK_BIT; k <= to / BITMAP_SPARSE_CHUNK_BIT; k++) {
+      c = map->chunks + k;
+      
+      first = k == from / BITMAP_SPARSE_CHUNK_BIT ? from % BITMAP_SPARSE_CHUNK_BIT : 0;
+      last = k == to / BITMAP_SPARSE_CHUNK_BIT ? to % BITMAP_SPARSE_CHUNK_BIT : BITMAP_SPARSE_CHUNK_BIT - 1;
+      
+      old_card = c->cardinality;
+      
+      ret = map_blocks_sparse_assign_range(c, first, last, input_value, s_b_sparse_chunk_bits(map, k));
+      
+      map->number_of_ones = map->number_of_ones - old_card + c->cardinality;
+      
+      // chunks done so far stay written
+      if (ret != 0) {
+         printf("bitmap_sparse_write_range : failed to allocate container\n");
+         break;
+      }
    }
-   if (!((offsets >> OFF_NZ)&0x1)) {
-      printf("map->number_of_zeros[0]* : %u\n", map->number_of_zeros_a[0]);
-      printf("map->number_of_zeros[1]  : %u\n", map->number_of_zeros_a[1]);
+   
+   map->number_of_zeros = map->length - map->number_of_ones;
+   
+   return ret;
+}
+
+int bitmap_sparse_first_one_bit_index (simple_sparse_bitmap* map, bit_index* result, bit_index skip_to_bit) {
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_sparse_first_one_bit_index : map is NULL\n");
+      return WRONG_INPUT;
    }
-   else {
-      printf("map->number_of_zeros[0]  : %u\n", map->number_of_zeros_a[0]);
-      printf("map->number_of_zeros[1]* : %u\n", map->number_of_zeros_a[1]);
+   if (map->chunks == NULL) {
+      printf("bitmap_sparse_first_one_bit_index : map is not initialised\n");
+      return CORRUPTED_DATA;
    }
-   if (!((offsets >> OFF_NO)&0x1)) {
-      printf("map->number_of_ones[0]*  : %u\n", map->number_of_ones_a[0]);
-      printf("map->number_of_ones[1]   : %u\n", map->number_of_ones_a[1]);
+   if (result == NULL) {
+      printf("bitmap_sparse_first_one_bit_index : result is null\n");
+      return WRONG_INPUT;
    }
-   else {
-      printf("map->number_of_ones[0]   : %u\n", map->number_of_ones_a[0]);
-      printf("map->number_of_ones[1]*  : %u\n", map->number_of_ones_a[1]);
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_sparse_first_one_bit_index : skip_to_bit is out of range\n");
+      return WRONG_INPUT;
    }
+   #endif
    
-   rand_indicators = map->rand_indicators;
-   
-   printf("map->rand_indicators : %x\n", rand_indicators);
-   printf("map->rand_degrees :\n");
-   for (count = 0; count < 5; count++) {
-      printf("   [%d][%d] : %d, ", count, 0, map->rand_degrees[count][0]);
-      printf("   [%d][%d] : %d\n", count, 1, map->rand_degrees[count][1]);
-   }
+   *result = map_blocks_sparse_find_bit_fwd(map, skip_to_bit, 0x1);
    
-   /*printf("map->rand_revert_to : ");
-   for (count = 0; count < sizeof(map->rand_revert_to)-1; count++) {
-      printf("%x, ", map->rand_revert_to[count]);
+   if (*result >= map->length) {
+      return SEARCH_FAIL;
    }
-   printf("%x\n", map->rand_revert_to[count]);*/
-   #endif
-   
-   printf("####################\n");
    
    return 0;
 }
 
-int bitmap_cont_group_show (bitmap_cont_group* grp) {
+int bitmap_sparse_first_zero_bit_index (simple_sparse_bitmap* map, bit_index* result, bit_index skip_to_bit) {
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
-   if (grp == NULL) {
-      printf("bitmap_cont_group_show : grp is NULL\n");
+   if (map == NULL) {
+      printf("bitmap_sparse_first_zero_bit_index : map is NULL\n");
+      return WRONG_INPUT;
+   }
+   if (map->chunks == NULL) {
+      printf("bitmap_sparse_first_zero_bit_index : map is not initialised\n");
+      return CORRUPTED_DATA;
+   }
+   if (result == NULL) {
+      printf("bitmap_sparse_first_zero_bit_index : result is null\n");
+      return WRONG_INPUT;
+   }
+   if (skip_to_bit >= map->length) {
+      printf("bitmap_sparse_first_zero_bit_index : skip_to_bit is out of range\n");
       return WRONG_INPUT;
    }
    #endif
-   printf("####################\n");
    
-   printf("grp->bit_type : %x\n", grp->bit_type);
-   printf("grp->start  : %d\n", (int) grp->start);
-   printf("grp->length : %d\n", (int) grp->length);
+   *result = map_blocks_sparse_find_bit_fwd(map, skip_to_bit, 0x0);
    
-   printf("####################\n");
+   if (*result >= map->length) {
+      return SEARCH_FAIL;
+   }
    
    return 0;
 }
 
-int bitmap_raw_show (simple_bitmap* map) {
-   uint_fast16_t count;
+int bitmap_sparse_count_zeros_and_ones (simple_sparse_bitmap* map) {
+   bit_index k;
    
-   map_block* cur;
+   bit_index ones;
    
    // input check
    #ifndef SIMPLE_BITMAP_SKIP_CHECK
    if (map == NULL) {
-      printf("bitmap_raw_show : map is NULL\n");
+      printf("bitmap_sparse_count_zeros_and_ones : map is NULL\n");
       return WRONG_INPUT;
    }
-   if (map->base == NULL) {
-      printf("bitmap_raw_show : base is NULL\n");
-      return CORRUPTED_DATA;
-   }
-   if (map->end == NULL) {
-      printf("bitmap_raw_show : end is NULL\n");
+   if (map->chunks == NULL) {
+      printf("bitmap_sparse_count_zeros_and_ones : map is not initialised\n");
       return CORRUPTED_DATA;
    }
-   if (map->length == 0) {
-      printf("bitmap_raw_show : map has no length\n");
-      return CORRUPTED_DATA;
+   #endif
+   
+   ones = 0;
+   for (k = 0; k < map->chunk_number; k++) {
+      ones += map->chunks[k].cardinality;
    }
-   if (map->base + get_bitmap_map_block_index(map->length-1) != map->end) {
-      printf("bitmap_raw_show : length is inconsistent with base and end\n");
-      return CORRUPTED_DATA;
+   
+   map->number_of_ones = ones;
+   map->number_of_zeros = map->length - ones;
+   
+   return 0;
+}
+
+int bitmap_sparse_memory_usage (simple_sparse_bitmap* map, size_t* result) {
+   bitmap_sparse_container* c;
+   
+   bit_index k;
+   
+   // input check
+   #ifndef SIMPLE_BITMAP_SKIP_CHECK
+   if (map == NULL) {
+      printf("bitmap_sparse_memory_usage : map is NULL\n");
+      return WRONG_INPUT;
    }
-   if (map->number_of_zeros + map->number_of_ones != map->length) {
-      printf("bitmap_raw_show : inconsistent statistics of number of ones and zeros\n");
-      return CORRUPTED_DATA;
+   if (result == NULL) {
+      printf("bitmap_sparse_memory_usage : result is NULL\n");
+      return WRONG_INPUT;
    }
    #endif
-   printf("####################\n");
    
-   printf("bitmap_raw :\n");
+   *result = sizeof(simple_sparse_bitmap) + sizeof(bitmap_sparse_container) * map->chunk_number;
    
-   count = 0;
-   for (cur = map->base; cur <= map->end; cur++) {
-      printf("%02X ", *cur);
-      if (count == 15) {
-         count = 0;
-         printf("\n");
-      }
-      else {
-         count++;
+   for (k = 0; k < map->chunk_number; k++) {
+      c = map->chunks + k;
+      switch (c->type) {
+         case BITMAP_SPARSE_ARRAY :
+            *result += c->capacity * sizeof(uint16_t);
+            break;
+         case BITMAP_SPARSE_BITSET :
+            *result += S_B_SPARSE_BITSET_BYTES;
+            break;
+         case BITMAP_SPARSE_RUN :
+            *result += c->capacity * 2 * sizeof(uint16_t);
+            break;
       }
    }
-   printf("\n");
-   
-   printf("####################\n");
    
    return 0;
-}
\ No newline at end of file
+}
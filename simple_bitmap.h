@@ -4,7 +4,11 @@
  * Version : 0.09
  * 
  * Note:
- *    simple bitmap is NOT thread safe
+ *    simple bitmap is NOT thread safe,
+ *    except for the bitmap_atomic_* functions(see SIMPLE_BITMAP_ATOMIC)
+ * 
+ *    SIMPLE_BITMAP_PARALLEL only spreads a single call over several threads,
+ *    it does not make the functions safe to call concurrently on the same map
  * 
  * License:
  * This is free and unencumbered software released into the public domain.
@@ -42,6 +46,24 @@
 
 //#define SIMPLE_BITMAP_META_DATA_SECURITY
 
+// enables the bitmap_atomic_* functions for concurrent writers, requires C11 atomics or GCC builtins
+//#define SIMPLE_BITMAP_ATOMIC
+
+// enables the thread pool used by the bulk functions on large maps, requires pthread
+//#define SIMPLE_BITMAP_PARALLEL
+
+// enables the bitmap_file_* functions for maps stored in memory-mapped files, requires POSIX mmap
+//#define SIMPLE_BITMAP_MMAP
+
+/* width of map_block in bits, one of 8, 32 or 64
+ *    the bit order is always MSB first within a map block,
+ *    i.e. bit index 0 is the most significant bit of the first map block
+ *
+ *    wider map blocks let every function work one word at a time,
+ *    which is noticeably faster for large maps
+ */
+//#define SIMPLE_BITMAP_MAP_BLOCK_BIT 64
+
 #ifndef SIMPLE_BITMAP_SILENT
    #include <stdio.h>
 #endif
@@ -52,16 +74,31 @@
 
 #include <limits.h>
 
+#include <string.h>
+
+#include <stdlib.h>
+
 #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
    #include "rand.h"
    #include <time.h>
-   #include <string.h>
    #include <pthread.h>
 #else
    #define bitmap_meta_encrypt(...)
    #define bitmap_meta_decrypt(...)
 #endif
 
+#ifdef SIMPLE_BITMAP_PARALLEL
+   #include <pthread.h>
+#endif
+
+#ifdef SIMPLE_BITMAP_MMAP
+   #include <sys/types.h>
+   #include <sys/mman.h>
+   #include <sys/stat.h>
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
 #include "simple_something_error.h"
 
 #define get_bitmap_map_block_number(size_in_bits)   ((size_in_bits) / MAP_BLOCK_BIT + (((size_in_bits) % MAP_BLOCK_BIT) == 0 ? 0 : 1))
@@ -69,12 +106,44 @@
 #define get_bitmap_map_block_bit_index(bit_index)   ((bit_index) % (MAP_BLOCK_BIT))
 #define get_bitmap_excess_bits(bit_index)           ((bit_index) % (MAP_BLOCK_BIT))
 
-#define MAP_BLOCK_BIT   CHAR_BIT
+// number of map blocks needed by a summary index covering a map of size_in_bits bits
+#define get_bitmap_summary_level1_number(size_in_bits)   get_bitmap_map_block_number(get_bitmap_map_block_number(size_in_bits))
+#define get_bitmap_summary_level2_number(size_in_bits)   get_bitmap_map_block_number(get_bitmap_summary_level1_number(size_in_bits))
+#define get_bitmap_summary_map_block_number(size_in_bits) \
+   (2 * (get_bitmap_summary_level1_number(size_in_bits) + get_bitmap_summary_level2_number(size_in_bits)))
+
+// bits covered by one entry of the rank index, a multiple of every map block size
+#define BITMAP_RANK_SUPERBLOCK_BIT 512
+// number of entries(bit_index) needed by a rank index covering a map of size_in_bits bits
+#define get_bitmap_rank_entry_number(size_in_bits) \
+   (((size_in_bits) + BITMAP_RANK_SUPERBLOCK_BIT - 1) / BITMAP_RANK_SUPERBLOCK_BIT)
+
+#ifndef SIMPLE_BITMAP_MAP_BLOCK_BIT
+   #define SIMPLE_BITMAP_MAP_BLOCK_BIT 8
+#endif
+
+#if   SIMPLE_BITMAP_MAP_BLOCK_BIT == 64
+   typedef uint64_t map_block;         // map block must be unsigned
+   #define MAP_BLOCK_BIT   64
+#elif SIMPLE_BITMAP_MAP_BLOCK_BIT == 32
+   typedef uint32_t map_block;         // map block must be unsigned
+   #define MAP_BLOCK_BIT   32
+#elif SIMPLE_BITMAP_MAP_BLOCK_BIT == 8
+   typedef unsigned char map_block;    // map block must be unsigned
+   #define MAP_BLOCK_BIT   CHAR_BIT
+#else
+   #error "simple_bitmap : SIMPLE_BITMAP_MAP_BLOCK_BIT must be 8, 32 or 64"
+#endif
 
-typedef unsigned char map_block;    // map block must be unsigned
 typedef struct simple_bitmap simple_bitmap;
 typedef uint_fast32_t bit_index;
 typedef struct bitmap_cont_group bitmap_cont_group;
+typedef struct bitmap_cont_group_iter bitmap_cont_group_iter;
+typedef struct bitmap_handle bitmap_handle;
+typedef struct simple_sparse_bitmap simple_sparse_bitmap;
+typedef struct bitmap_sparse_container bitmap_sparse_container;
+typedef struct simple_growable_bitmap simple_growable_bitmap;
+typedef struct bitmap_expr_op bitmap_expr_op;
 
 struct simple_bitmap {
    map_block* base;
@@ -83,6 +152,13 @@ struct simple_bitmap {
    
    bit_index number_of_zeros;
    bit_index number_of_ones;
+   
+   map_block* summary;        // optional summary index, NULL if not attached
+   bit_index summary_capacity;   // in bits
+   
+   bit_index* rank;           // optional rank index, NULL if not attached
+   bit_index rank_capacity;   // in bits
+   bit_index rank_valid;      // number of leading entries of the rank index that are up to date
    #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
    uint32_t obj_rand_encrypt_xor_meta;
    uint32_t obj_rand_encrypt_add_meta;
@@ -110,6 +186,8 @@ struct simple_bitmap {
    uint_least8_t rand_degrees[5][2];
    //unsigned char rand_revert_to[5];
    
+   unsigned int unlock_depth;    // decryptions not yet matched by an encryption, kept in plain
+   
    #endif
 };
 
@@ -119,6 +197,112 @@ struct bitmap_cont_group {
    bit_index length;
 };
 
+// state of a walk over the continuous groups of a map, see bitmap_cont_group_iter_init
+struct bitmap_cont_group_iter {
+   simple_bitmap* map;     // the map walked over, its meta data is decrypted for each step only
+   bit_index pos;          // forward : next bit to look at, backward : one past it
+   map_block bit_type;
+   char direction;
+};
+
+// one step of a bitmap expression, see bitmap_expr_eval
+struct bitmap_expr_op {
+   unsigned char code;     // one of BITMAP_EXPR_*
+   bit_index operand;      // index into the maps for BITMAP_EXPR_PUSH, unused otherwise
+};
+
+// a map checked out by bitmap_checkout, see below
+struct bitmap_handle {
+   simple_bitmap* map;        // decrypted while checked out
+   map_block* base;
+   bit_index length;
+};
+
+// number of bits covered by one container of a sparse bitmap
+#define BITMAP_SPARSE_CHUNK_BIT  65536
+
+// container types
+#define BITMAP_SPARSE_EMPTY   0
+#define BITMAP_SPARSE_ARRAY   1
+#define BITMAP_SPARSE_BITSET  2
+#define BITMAP_SPARSE_RUN     3
+
+struct bitmap_sparse_container {
+   unsigned char type;
+   uint_fast32_t cardinality;    // number of one bits
+   uint_fast32_t size;           // values(array) or runs(run) in use
+   uint_fast32_t capacity;       // values or runs allocated
+   union {
+      uint16_t* values;    // array : sorted offsets of the one bits
+      uint64_t* words;     // bitset : one bit per offset, least significant bit first
+      uint16_t* runs;      // run : sorted pairs of the first and last offset of each run of one bits
+   } data;
+};
+
+// compressed bitmap, see bitmap_sparse_init below
+struct simple_sparse_bitmap {
+   bitmap_sparse_container* chunks;    // one per BITMAP_SPARSE_CHUNK_BIT bits
+   bit_index chunk_number;
+   bit_index length;
+   
+   bit_index number_of_zeros;
+   bit_index number_of_ones;
+};
+
+// bitmap owning its map blocks, see bitmap_growable_init below
+struct simple_growable_bitmap {
+   simple_bitmap map;      // usable with the other functions, except bitmap_grow and bitmap_shrink
+   bit_index capacity;     // bits allocated, a multiple of MAP_BLOCK_BIT
+};
+
+#ifdef SIMPLE_BITMAP_ATOMIC
+// number of counter stripes, threads are spread over them
+#define SIMPLE_BITMAP_ATOMIC_STRIPES 16
+
+typedef struct bitmap_atomic bitmap_atomic;
+
+// concurrent view of a checked out map, see below
+struct bitmap_atomic {
+   bitmap_handle* handle;
+   struct {
+      long ones_delta;
+      char padding[64 - sizeof(long)];    // one stripe per cache line
+   } stripes[SIMPLE_BITMAP_ATOMIC_STRIPES];
+};
+#endif
+
+#ifdef SIMPLE_BITMAP_MMAP
+// bytes in front of the first map block of a bitmap file
+#define BITMAP_FILE_HEADER_SIZE  64
+
+#define BITMAP_FILE_MAGIC  "SBITMAP1"    // 8 bytes, no terminating 0 in the file
+
+typedef struct bitmap_file_header bitmap_file_header;
+
+struct bitmap_file_header {
+   char magic[8];
+   uint32_t map_block_bit;    // MAP_BLOCK_BIT of the program that created the file
+   uint32_t clean;            // 1 if the file was last closed by bitmap_file_close
+   uint64_t length;           // in bits
+   uint64_t number_of_ones;   // up to date only if clean is 1
+   unsigned char reserved[BITMAP_FILE_HEADER_SIZE - 32];
+};
+#endif
+
+#ifdef SIMPLE_BITMAP_PARALLEL
+// maps shorter than this(in bits) are always handled by the calling thread
+#ifndef SIMPLE_BITMAP_PARALLEL_THRESHOLD
+   #define SIMPLE_BITMAP_PARALLEL_THRESHOLD (1UL << 24)
+#endif
+
+// largest number of threads in the pool, counting the calling thread
+#define SIMPLE_BITMAP_PARALLEL_MAX_THREADS 64
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* Scheme:
  *    randomise all keys, if unrandomised
  *    (obj_rand_encrypt_xor_meta + rand_encrypt_add_meta)
@@ -126,18 +310,13 @@ struct bitmap_cont_group {
  *       is used to xor encrypt/decrypt the data
  */
 #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
-uint_fast32_t  rand_encrypt_xor_meta;
-uint_fast32_t  rand_encrypt_add_meta;
-uint_fast32_t  rand_encrypt_xor_meta2;
-uint_fast32_t  rand_encrypt_add_meta2;
-uint_fast32_t  rand_cookie_correct_meta;
-randctx s_b_rand_ctx;
-unsigned char rand_things_init;
-pthread_mutex_t rand_things_init_lock;
-#endif
-
-#ifdef __cplusplus
-extern "C" {
+// defined in simple_bitmap.c
+extern uint_fast32_t  rand_encrypt_xor_meta;
+extern uint_fast32_t  rand_encrypt_add_meta;
+extern uint_fast32_t  rand_encrypt_xor_meta2;
+extern uint_fast32_t  rand_encrypt_add_meta2;
+extern uint_fast32_t  rand_cookie_correct_meta;
+extern randctx s_b_rand_ctx;  // only used to seed the random context of each thread
 #endif
 
 /* default value :
@@ -148,8 +327,36 @@ extern "C" {
 int bitmap_init   (simple_bitmap* map, map_block* base, map_block* end, uint_fast32_t size_in_bits, map_block default_value);
 
 #ifdef SIMPLE_BITMAP_META_DATA_SECURITY
+// decryptions and encryptions nest, only the outermost pair does the actual work,
+// so functions called while the map is decrypted skip their own crypt round trip
 int bitmap_meta_encrypt (simple_bitmap* map);
 int bitmap_meta_decrypt (simple_bitmap* map);
+
+// unlock session
+/* Note:
+ *    bitmap_meta_unlock decrypts the meta data once,
+ *    all bitmap functions called on the map until bitmap_meta_relock skip decryption and encryption
+ * 
+ *    bitmap_meta_relock ending the outermost session picks new keys and a new layout
+ *    for the meta data before encrypting it, so the encrypted meta data
+ *    has nothing in common with the one before unlocking
+ * 
+ *    the meta data is in plain memory during the session, keep sessions short
+ * 
+ *    both are inline no-ops returning 0 when SIMPLE_BITMAP_META_DATA_SECURITY is not defined
+ */
+int bitmap_meta_unlock  (simple_bitmap* map);
+int bitmap_meta_relock  (simple_bitmap* map);
+#else
+static inline int bitmap_meta_unlock (simple_bitmap* map) {
+   (void) map;
+   return 0;
+}
+
+static inline int bitmap_meta_relock (simple_bitmap* map) {
+   (void) map;
+   return 0;
+}
 #endif
 
 int bitmap_data_check   (simple_bitmap* map);   // potentially expensive as it goes through entire bitmap
@@ -180,22 +387,96 @@ int bitmap_one    (simple_bitmap* map);
  *       1 - overwrite space with 1s
  *      >1 - leave the space as it is
  * 
- *    The rotation algorithm used within has been verified formally(mathematically),
- *    the actual proof is provided in s_b_bitshift_proof.txt file(unix newline encoding)
+ *    Bits are moved 64 at a time with funnel shifts, or with memmove when
+ *    the offset is a multiple of the map block size, in a single pass over the map
  * 
- *    The rotation algorithm was devised independently, thus the style and proof
- *    may not match any of the implemention done by others
+ *    Rotation swaps the two parts of the map through a fixed 1KB buffer on the stack
+ *    until the shorter part fits in the buffer, then rotates it around the longer part
  */
 int bitmap_shift  (simple_bitmap* map, bit_index offset, char direction, map_block default_val, unsigned char wrap_around);
 
 int bitmap_not    (simple_bitmap* map);
+
+// the result is written over the whole of ret_map and counted in the same pass
+// bits of map1 or map2 beyond their lengths are treated as 0s
 int bitmap_and    (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map, unsigned char enforce_same_size);
 int bitmap_or     (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map, unsigned char enforce_same_size);
 int bitmap_xor    (simple_bitmap* map1, simple_bitmap* map2, simple_bitmap* ret_map, unsigned char enforce_same_size);
 
+// counts and comparisons of map1 and map2 without writing a result map
+/* Note:
+ *    bits of map1 or map2 beyond their lengths are treated as 0s, as in bitmap_and
+ *
+ *    the counts take a single pass counting map1 & map2,
+ *    the or and xor counts follow from the number of ones of each map
+ *
+ *    bitmap_equal, bitmap_is_subset and bitmap_intersects stop at the first word that decides the result,
+ *    and skip the pass entirely when the number of ones already does
+ *
+ *    bitmap_equal is false for maps of different lengths,
+ *    bitmap_is_subset tests whether every one bit of map1 is also set in map2
+ */
+int bitmap_and_count    (simple_bitmap* map1, simple_bitmap* map2, bit_index* result);
+int bitmap_or_count     (simple_bitmap* map1, simple_bitmap* map2, bit_index* result);
+int bitmap_xor_count    (simple_bitmap* map1, simple_bitmap* map2, bit_index* result);
+
+int bitmap_equal        (simple_bitmap* map1, simple_bitmap* map2, unsigned char* result);
+int bitmap_is_subset    (simple_bitmap* map1, simple_bitmap* map2, unsigned char* result);
+int bitmap_intersects   (simple_bitmap* map1, simple_bitmap* map2, unsigned char* result);
+
+// fused evaluation of an expression over any number of maps
+/* Note:
+ *    the expression is a postfix program over a stack of operands,
+ *    e.g. (a & b & ~c) | d with maps {a, b, c, d} is
+ *       PUSH 0, PUSH 1, AND, PUSH 2, ANDNOT, PUSH 3, OR
+ *    and the masked blend (a & m) | (b & ~m) with maps {a, b, m} is
+ *       PUSH 0, PUSH 1, PUSH 2, BLEND
+ * 
+ *    the program must leave exactly one operand on the stack,
+ *    and never hold more than BITMAP_EXPR_MAX_DEPTH at a time
+ * 
+ *    all maps and ret_map must be of the same length,
+ *    the maps are read and ret_map written in a single pass, one cache sized chunk at a time,
+ *    ret_map may be one of the maps
+ * 
+ *    ret_map may be NULL to only count the one bits of the result,
+ *    ones may be NULL if the count is not needed
+ */
+#define BITMAP_EXPR_PUSH      0     // pushes maps[operand]
+#define BITMAP_EXPR_NOT       1     // x        -> ~x
+#define BITMAP_EXPR_AND       2     // x y      -> x & y
+#define BITMAP_EXPR_OR        3     // x y      -> x | y
+#define BITMAP_EXPR_XOR       4     // x y      -> x ^ y
+#define BITMAP_EXPR_ANDNOT    5     // x y      -> x & ~y
+#define BITMAP_EXPR_BLEND     6     // x y m    -> (x & m) | (y & ~m)
+
+#define BITMAP_EXPR_MAX_DEPTH 16
+
+int bitmap_expr_eval (const bitmap_expr_op* prog, bit_index prog_len, simple_bitmap** maps, bit_index map_num,
+                      simple_bitmap* ret_map, bit_index* ones);
+
 int bitmap_read   (simple_bitmap* map, uint_fast32_t index, map_block* result,     unsigned char no_auto_crypt);
 int bitmap_write  (simple_bitmap* map, uint_fast32_t index, map_block input_value, unsigned char no_auto_crypt);
 
+// batch versions of read and write, the map is checked and decrypted only once for all count indices
+/* Note:
+ *    results[i] / input_values[i] belong to indices[i]
+ *    bitmap_write_batch checks all indices before writing any bit,
+ *    writes are applied in order, so the last write to a repeated index wins
+ */
+int bitmap_read_batch   (simple_bitmap* map, const bit_index* indices, bit_index count, map_block* results,            unsigned char no_auto_crypt);
+int bitmap_write_batch  (simple_bitmap* map, const bit_index* indices, bit_index count, const map_block* input_values, unsigned char no_auto_crypt);
+
+// range versions of read and write, both from and to are inclusive
+// the map is checked only once for the whole range
+/* result of bitmap_read_range :
+ *    0 - all bits in range are 0s
+ *    1 - all bits in range are 1s
+ *    2 - bits in range are mixed
+ */
+int bitmap_read_range   (simple_bitmap* map, bit_index from, bit_index to, map_block* result,     unsigned char no_auto_crypt);
+int bitmap_write_range  (simple_bitmap* map, bit_index from, bit_index to, map_block input_value, unsigned char no_auto_crypt);
+
 int bitmap_first_one_bit_index   (simple_bitmap* map, uint_fast32_t* result, bit_index skip_to_bit);
 int bitmap_first_zero_bit_index  (simple_bitmap* map, uint_fast32_t* result, bit_index skip_to_bit);
 
@@ -214,11 +495,116 @@ int bitmap_first_zero_bit_index_back  (simple_bitmap* map, uint_fast32_t* result
 int bitmap_first_one_cont_group_back     (simple_bitmap* map, bitmap_cont_group* ret_grp, bit_index skip_to_bit);
 int bitmap_first_zero_cont_group_back    (simple_bitmap* map, bitmap_cont_group* ret_grp, bit_index skip_to_bit);
 
+// iterator over all continuous groups
+/* Note:
+ *    bitmap_cont_group_iter_init checks the map once, after which
+ *    each bitmap_cont_group_iter_next returns the next group in a single pass over the map,
+ *    instead of searching again from skip_to_bit for every group
+ * 
+ *    bit_type:
+ *       0 - groups of zeros
+ *       1 - groups of ones
+ *      >1 - groups of both types, one after another
+ * 
+ *    direction:
+ *      >= 0 - from skip_to_bit towards the end of the map
+ *       < 0 - from skip_to_bit towards the start of the map
+ * 
+ *    groups are the same as returned by the bitmap_first_*_cont_group(_back) functions,
+ *    i.e. the first group is cut off at skip_to_bit
+ * 
+ *    bitmap_cont_group_iter_next returns SEARCH_FAIL once there are no more groups
+ * 
+ *    the map must not be modified, grown or shrunk during iteration,
+ *    the iterator refers to the map and keeps none of its meta data
+ */
+int bitmap_cont_group_iter_init  (simple_bitmap* map, bitmap_cont_group_iter* iter, map_block bit_type, char direction, bit_index skip_to_bit);
+int bitmap_cont_group_iter_next  (bitmap_cont_group_iter* iter, bitmap_cont_group* ret_grp);
+
+// enumeration of one bits, a map block(or 64 bits) at a time instead of one search per bit
+/* Note:
+ *    bitmap_for_each_one calls callback(index, arg) for each one bit from bit from to bit to(inclusive)
+ *    in increasing order, a non-zero return value of callback stops the enumeration,
+ *    callback may call other bitmap functions on the map but should not modify it
+ * 
+ *    bitmap_to_indices writes the indices of the first max one bits at or after skip_to_bit
+ *    into out in increasing order, and their number into count,
+ *    continue from out[count-1] + 1 to get the next ones
+ * 
+ *    bitmap_from_indices is the inverse, the map is cleared and the bits at indices are set,
+ *    indices need not be sorted or unique, nothing is written unless all of them are in range
+ */
+int bitmap_for_each_one    (simple_bitmap* map, bit_index from, bit_index to, int (*callback) (bit_index, void*), void* arg);
+int bitmap_to_indices      (simple_bitmap* map, bit_index skip_to_bit, bit_index* out, bit_index max, bit_index* count);
+int bitmap_from_indices    (simple_bitmap* map, const bit_index* indices, bit_index count);
+
 int bitmap_count_zeros_and_ones (simple_bitmap* map);
 
+// optional summary index for the searching functions
+/* Note:
+ *    The summary has two levels, for both one bits and zero bits
+ *       level 1 : bit i says whether map block i has any one(zero) bit
+ *       level 2 : bit j says whether map block j of level 1 has any bit set
+ *    so the searching functions can skip long runs of all zero(one) map blocks
+ *    instead of scanning them
+ * 
+ *    summary_base must point to get_bitmap_summary_map_block_number(capacity_in_bits)
+ *    map blocks, capacity_in_bits is the largest length the map may grow to,
+ *    0 means the current length of the map
+ * 
+ *    bitmap_write updates the summary in constant time,
+ *    all other functions that modify the map rebuild it
+ * 
+ *    bitmap_grow detaches the summary if the new length exceeds the capacity
+ * 
+ *    bitmap_init detaches any summary
+ */
+int bitmap_summary_attach (simple_bitmap* map, map_block* summary_base, uint_fast32_t capacity_in_bits);
+int bitmap_summary_detach (simple_bitmap* map);
+
+// optional rank index for bitmap_rank, bitmap_count_range and bitmap_select
+/* Note:
+ *    entry i holds the number of one bits before bit i * BITMAP_RANK_SUPERBLOCK_BIT,
+ *    so a rank is one entry plus the popcount of at most one superblock,
+ *    and a select is a binary search over the entries plus a scan of one superblock
+ * 
+ *    rank_base must point to get_bitmap_rank_entry_number(capacity_in_bits)
+ *    entries, capacity_in_bits is the largest length the map may grow to,
+ *    0 means the current length of the map
+ * 
+ *    the index is updated lazily, functions that modify the map only mark
+ *    the entries after the first modified superblock as stale,
+ *    and the next query counts them again up to where it needs them
+ * 
+ *    bitmap_grow and the growable functions detach the index if the new length exceeds the capacity
+ * 
+ *    bitmap_init detaches any rank index
+ */
+int bitmap_rank_attach (simple_bitmap* map, bit_index* rank_base, uint_fast32_t capacity_in_bits);
+int bitmap_rank_detach (simple_bitmap* map);
+
+// rank and select, the rank index is used if attached, otherwise the map blocks are counted
+/* Note:
+ *    bitmap_rank gives the number of one bits before bit index, index may be equal to the length of the map
+ * 
+ *    bitmap_count_range gives the number of one bits from bit from to bit to, both inclusive
+ * 
+ *    bitmap_select gives the index of the k-th one bit, counted from 0,
+ *    returns SEARCH_FAIL if the map has no more than k one bits
+ */
+int bitmap_rank         (simple_bitmap* map, bit_index index, bit_index* result);
+int bitmap_count_range  (simple_bitmap* map, bit_index from, bit_index to, bit_index* result);
+int bitmap_select       (simple_bitmap* map, bit_index k, bit_index* result);
+
 // both maps must be initialised
 int bitmap_copy (simple_bitmap* src_map, simple_bitmap* dst_map, unsigned char allow_truncate, map_block default_value);
 
+// copies count bits of src_map starting at src_from to dst_map starting at dst_from
+// both maps must be initialised, and may be the same map with overlapping ranges, same as memmove
+// counts of dst_map are updated from the bits overwritten and the bits written,
+// bits of dst_map outside the range are untouched
+int bitmap_copy_range (simple_bitmap* src_map, bit_index src_from, simple_bitmap* dst_map, bit_index dst_from, bit_index count);
+
 // no data checks, only copying
 int bitmap_meta_copy (simple_bitmap* src_map, simple_bitmap* dst_map);
 
@@ -232,10 +618,233 @@ int bitmap_meta_copy (simple_bitmap* src_map, simple_bitmap* dst_map);
 int bitmap_grow (simple_bitmap* map, map_block* end, uint_fast32_t size_in_bits, map_block default_value);
 int bitmap_shrink (simple_bitmap* map, map_block* end, uint_fast32_t size_in_bits);
 
+// growable bitmap
+/* Note:
+ *    unlike simple_bitmap, the map blocks are allocated with malloc,
+ *    bitmap_growable_free releases them
+ * 
+ *    capacity is kept apart from length and at least doubles whenever it runs out,
+ *    so appending a few bits at a time costs amortised constant time
+ * 
+ *    map blocks beyond the length are kept as 0s, resizing only fills the new bits
+ *    when default value is 1, and counts are updated from the bits added or cut off
+ * 
+ *    the map may be empty(length 0), only the functions below accept it in that case
+ * 
+ *    the map blocks may move when the capacity grows, pointers into them and checked out
+ *    handles must not be kept across bitmap_growable_reserve, resize and append
+ * 
+ *    an attached summary is detached once the length exceeds its capacity, same as bitmap_grow
+ * 
+ *    default value is 0 or 1
+ * 
+ *    functions that may need memory return MEM_ALLOC_FAIL if it cannot be obtained,
+ *    the map is left as it was in that case
+ */
+int bitmap_growable_init      (simple_growable_bitmap* gmap, uint_fast32_t size_in_bits, map_block default_value);
+int bitmap_growable_free      (simple_growable_bitmap* gmap);
+
+// capacity never shrinks
+int bitmap_growable_reserve   (simple_growable_bitmap* gmap, uint_fast32_t capacity_in_bits);
+
+int bitmap_growable_resize    (simple_growable_bitmap* gmap, uint_fast32_t size_in_bits, map_block default_value);
+int bitmap_growable_append    (simple_growable_bitmap* gmap, map_block input_value);
+
 int bitmap_show (simple_bitmap* map);
 int bitmap_cont_group_show (bitmap_cont_group* grp);
 int bitmap_raw_show (simple_bitmap* map);
 
+// checked out handle
+/* Note:
+ *    bitmap_checkout validates(and decrypts) the map once,
+ *    after which the bitmap_handle_* functions below work on the map
+ *    with only the bit arithmetic, no checks and no crypt round trip
+ * 
+ *    index must be smaller than handle->length, this is NOT checked
+ * 
+ *    the counts of zeros and ones, the summary index and the rank index are kept up to date
+ * 
+ *    while checked out, the map may be passed to other bitmap functions,
+ *    which skip their crypt round trip as the map stays decrypted,
+ *    bitmap_release re-encrypts the map and invalidates the handle
+ */
+int bitmap_checkout (simple_bitmap* map, bitmap_handle* handle);
+int bitmap_release  (bitmap_handle* handle);
+
+// INTERNAL USE, refreshes the summary index of the map block holding index
+// and marks the rank index stale from there on
+int bitmap_handle_summary_update (bitmap_handle* handle, bit_index index);
+
+static inline map_block bitmap_handle_read (bitmap_handle* handle, bit_index index) {
+   return (handle->base[get_bitmap_map_block_index(index)]
+            >> (MAP_BLOCK_BIT - 1 - get_bitmap_map_block_bit_index(index))) & 0x1;
+}
+
+static inline int bitmap_handle_write (bitmap_handle* handle, bit_index index, map_block input_value) {
+   map_block* block = handle->base + get_bitmap_map_block_index(index);
+   
+   map_block mask = (map_block) 0x1 << (MAP_BLOCK_BIT - 1 - get_bitmap_map_block_bit_index(index));
+   
+   if (!(*block & mask) == !(input_value & 0x1)) {
+      return 0;
+   }
+   
+   *block ^= mask;
+   
+   if (input_value & 0x1) {
+      handle->map->number_of_zeros    --;
+      handle->map->number_of_ones     ++;
+   }
+   else {
+      handle->map->number_of_zeros    ++;
+      handle->map->number_of_ones     --;
+   }
+   
+   if (handle->map->summary != NULL || handle->map->rank != NULL) {
+      bitmap_handle_summary_update(handle, index);
+   }
+   
+   return 0;
+}
+
+// sets the bit to 1, returns its previous value
+static inline map_block bitmap_handle_test_and_set (bitmap_handle* handle, bit_index index) {
+   map_block old_value = bitmap_handle_read(handle, index);
+   
+   if (!old_value) {
+      bitmap_handle_write(handle, index, 0x1);
+   }
+   
+   return old_value;
+}
+
+// sparse bitmap
+/* Note:
+ *    a compressed alternative to simple_bitmap for maps with few one bits(or few zero bits),
+ *    the map is split into chunks of BITMAP_SPARSE_CHUNK_BIT bits,
+ *    each kept in whichever container is smallest :
+ *       empty  - no one bits, no memory besides the container itself
+ *       array  - sorted offsets of the one bits, up to 4096 of them
+ *       bitset - plain 8K bytes bitset
+ *       run    - sorted runs of one bits, e.g. a chunk of all one bits takes 4 bytes
+ * 
+ *    unlike simple_bitmap, the containers are allocated with malloc,
+ *    bitmap_sparse_free releases them
+ * 
+ *    default value is 0 or 1
+ * 
+ *    functions that may need memory return MEM_ALLOC_FAIL if it cannot be obtained,
+ *    the map is left as it was in that case
+ * 
+ *    bitmap_sparse_test is the unchecked read, index must be smaller than map->length
+ */
+int bitmap_sparse_init  (simple_sparse_bitmap* map, uint_fast32_t size_in_bits, map_block default_value);
+int bitmap_sparse_free  (simple_sparse_bitmap* map);
+
+int bitmap_sparse_zero  (simple_sparse_bitmap* map);
+int bitmap_sparse_one   (simple_sparse_bitmap* map);
+
+int bitmap_sparse_read  (simple_sparse_bitmap* map, bit_index index, map_block* result);
+int bitmap_sparse_write (simple_sparse_bitmap* map, bit_index index, map_block input_value);
+
+map_block bitmap_sparse_test (simple_sparse_bitmap* map, bit_index index);
+
+// both from and to are inclusive
+int bitmap_sparse_write_range (simple_sparse_bitmap* map, bit_index from, bit_index to, map_block input_value);
+
+int bitmap_sparse_first_one_bit_index  (simple_sparse_bitmap* map, bit_index* result, bit_index skip_to_bit);
+int bitmap_sparse_first_zero_bit_index (simple_sparse_bitmap* map, bit_index* result, bit_index skip_to_bit);
+
+int bitmap_sparse_count_zeros_and_ones (simple_sparse_bitmap* map);
+
+// bytes used by the map, including the containers
+int bitmap_sparse_memory_usage (simple_sparse_bitmap* map, size_t* result);
+
+#ifdef SIMPLE_BITMAP_ATOMIC
+// atomic bit operations for concurrent writers
+/* Note:
+ *    bitmap_atomic_begin puts a checked out handle into atomic mode,
+ *    after which any number of threads may call the functions below
+ *    on the same map without a lock, bits are set and cleared with
+ *    atomic fetch-or/fetch-and on whole map blocks
+ *    (use SIMPLE_BITMAP_MAP_BLOCK_BIT 64 for 64-bit words)
+ * 
+ *    index must be smaller than the length of the map, this is NOT checked
+ * 
+ *    the change in the number of ones is kept in per-thread striped counters,
+ *    bitmap_atomic_count_ones sums them on demand,
+ *    bitmap_atomic_end folds them into the map and rebuilds the summary index,
+ *    and must only be called once all threads are done
+ * 
+ *    a release-acquire pair orders a set bit against data written before it,
+ *    i.e. a thread that sees a bit set by bitmap_atomic_test_and_set
+ *    also sees what the setting thread wrote before setting it
+ */
+int bitmap_atomic_begin (bitmap_handle* handle, bitmap_atomic* amap);
+int bitmap_atomic_end   (bitmap_atomic* amap);
+
+map_block bitmap_atomic_read (bitmap_atomic* amap, bit_index index);
+int       bitmap_atomic_write (bitmap_atomic* amap, bit_index index, map_block input_value);
+
+// both return the previous value of the bit
+map_block bitmap_atomic_test_and_set   (bitmap_atomic* amap, bit_index index);
+map_block bitmap_atomic_test_and_clear (bitmap_atomic* amap, bit_index index);
+
+bit_index bitmap_atomic_count_ones (bitmap_atomic* amap);
+#endif
+
+#ifdef SIMPLE_BITMAP_MMAP
+// bitmaps stored in memory-mapped files
+/* Note:
+ *    the file is a bitmap_file_header followed by the map blocks,
+ *    which are mapped shared, so the map is not read in when opened,
+ *    and is shared through the page cache with other processes mapping the same file
+ * 
+ *    bitmap_file_open creates the file if it does not exist or is empty,
+ *    with size_in_bits bits set to default value(same as bitmap_init),
+ *    otherwise size_in_bits must be 0 or the length stored in the file
+ * 
+ *    the counts are taken from the header if the file was closed by bitmap_file_close,
+ *    otherwise(e.g. the program crashed) they are counted again when opening,
+ *    bitmap_data_check can be called later to verify the counts taken from the header
+ * 
+ *    bitmap_file_sync writes the map blocks and the counts back to the file with msync,
+ *    bitmap_file_close does the same, marks the file as clean and unmaps it
+ * 
+ *    map blocks are stored in the byte order of the machine,
+ *    files created with MAP_BLOCK_BIT 32 or 64 can only be opened on machines of the same byte order,
+ *    and files are only opened with the same MAP_BLOCK_BIT they were created with
+ * 
+ *    a map opened by bitmap_file_open must not be grown, shrunk or initialised again,
+ *    and must be released by bitmap_file_close
+ */
+int bitmap_file_open    (simple_bitmap* map, const char* path, uint_fast32_t size_in_bits, map_block default_value);
+int bitmap_file_sync    (simple_bitmap* map);
+int bitmap_file_close   (simple_bitmap* map);
+#endif
+
+#ifdef SIMPLE_BITMAP_PARALLEL
+// thread pool for the bulk functions
+/* Note:
+ *    bitmap_parallel_init starts thread_count - 1 worker threads,
+ *    the thread calling a bulk function does its share of the work as well
+ * 
+ *    while the pool is running, bitmap_zero, bitmap_one, bitmap_not,
+ *    bitmap_and, bitmap_or, bitmap_xor, bitmap_count_zeros_and_ones and bitmap_copy
+ *    split maps of at least SIMPLE_BITMAP_PARALLEL_THRESHOLD bits into one chunk per thread,
+ *    chunks start on cache line boundaries of the map being written,
+ *    and the one bits counted in each chunk are added up at the end
+ * 
+ *    smaller maps, calls made while the pool is busy with another call,
+ *    and calls made while the pool is not running stay on the calling thread
+ * 
+ *    bitmap_parallel_shutdown stops and joins the worker threads,
+ *    it must not be called while a bulk function is running
+ */
+int bitmap_parallel_init     (int thread_count);
+int bitmap_parallel_shutdown (void);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,7 +4,8 @@
  * Version : 0.04
  * 
  * Note:
- *    The data structures themselves are not threadsafe
+ *    The data structures themselves are not threadsafe,
+ *    except for sfd_arr_read_mt/sfd_arr_write_mt(see sfd_arr_atomic_begin)
  * 
  * License:
  * This is free and unencumbered software released into the public domain.
@@ -80,15 +81,25 @@
    #define sfd_arr_dec_sta(type, name, size)                      type name[size]
    #define sfd_arr_dec_dyn(type, name, size)                      type* name = (type*) malloc(sizeof(type) * size)
    #define sfd_arr_dec_man(type, name, size, start_bmap, start)   type* name = start
+   #define sfd_arr_dec_sparse(type, name, size)                   type* name = (type*) malloc(sizeof(type) * size)
    #define sfd_arr_read(name, indx)                               name[indx]
    #define sfd_arr_write(name, indx, in_val)                      (name[indx] = in_val)
    #define sfd_arr_incre(name, indx, in_val)                      (name[indx] += in_val)
    #define sfd_arr_wipe(...)        0
+   #define sfd_arr_wipe_range(...)  0
    #define sfd_arr_def_con_ele(...)
    #define sfd_arr_def_con_arr(...)
    #define sfd_arr_enforce_con(...) 1
    #define sfd_arr_add_con_ele(...) 0
    #define sfd_arr_add_con_arr(...) 0
+   #define sfd_arr_def_con_inc(...)
+   #define sfd_arr_add_con_inc(...) 0
+   #define sfd_arr_batch_begin(...) 0
+   #define sfd_arr_batch_end(...)
+   #define sfd_arr_atomic_begin(...)   0
+   #define sfd_arr_atomic_end(...)
+   #define sfd_arr_read_mt(name, indx)            name[indx]
+   #define sfd_arr_write_mt(name, indx, in_val)   (name[indx] = in_val)
    #define sfd_arr_get_size(...)    0
    #define sfd_ptr_dec(type, name)  type name
    #define sfd_ptr_link(...)
@@ -130,6 +141,15 @@ static int sfd_memset(void *str, int c, size_t n) {
    return 0;
 }
 
+#ifdef SIMPLE_BITMAP_META_DATA_SECURITY
+// INTERNAL USE
+static map_block sfd_init_map_read(simple_bitmap* map, bit_index index) {
+   map_block result = 0;
+   bitmap_read(map, index, &result, 0);
+   return result;
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -146,11 +166,45 @@ static int sfd_memset(void *str, int c, size_t n) {
 #define SFD_FL_CON      0x8   // for all sfd data
 #define SFD_FL_CON_ELE  0x10  // for sfd arr
 #define SFD_FL_CON_ARR  0x20  // for sfd arr
+#define SFD_FL_BATCH    0x80  // for sfd arr
+#define SFD_FL_SPARSE   0x100 // for sfd arr
 #define SFD_FL_SFD_VAR  0x40  // for sfd ptr
 #define SFD_FL_BOUNDED  0x60  // for sfd ptr
 #define SFD_FL_CON_ADDR 0x200 // for sfd ptr
 #define SFD_FL_CON_VAL  0x400 // for sfd ptr
 
+// INTERNAL USE, access to the init map of sfd arrays not declared by sfd_arr_dec_sparse
+/* with SIMPLE_BITMAP_META_DATA_SECURITY the init map is not kept checked out,
+ * as that would leave its meta data decrypted for the lifetime of the array,
+ * each access goes through bitmap_read/bitmap_write and its crypt round trip instead,
+ * only atomic mode checks the map out, from sfd_arr_atomic_begin to sfd_arr_atomic_end
+ */
+#ifdef SIMPLE_BITMAP_META_DATA_SECURITY
+   #define sfd_arr_init_checkout(name)          0
+   #define sfd_arr_init_map_read(name, indx)    sfd_init_map_read(&name.init_map, indx)
+   #define sfd_arr_init_map_write(name, indx)   bitmap_write(&name.init_map, indx, 1, 0)
+   #define sfd_arr_init_map_one(name)           bitmap_one(&name.init_map)
+   #define sfd_arr_atomic_checkout(name)        bitmap_checkout(&name.init_map, &name.init_handle)
+   #define sfd_arr_atomic_release(name)         bitmap_release(&name.init_handle)
+#else
+   #define sfd_arr_init_checkout(name)          bitmap_checkout(&name.init_map, &name.init_handle)
+   #define sfd_arr_init_map_read(name, indx)    bitmap_handle_read(&name.init_handle, indx)
+   #define sfd_arr_init_map_write(name, indx)   bitmap_handle_write(&name.init_handle, indx, 1)
+   #define sfd_arr_init_map_one(name) \
+      (bitmap_release(&name.init_handle), bitmap_one(&name.init_map), bitmap_checkout(&name.init_map, &name.init_handle))
+   #define sfd_arr_atomic_checkout(name)        0
+   #define sfd_arr_atomic_release(name)         0
+#endif
+
+// INTERNAL USE, fields of sfd arrays for concurrent writers, see sfd_arr_atomic_begin
+#ifdef SIMPLE_BITMAP_ATOMIC
+   #define sfd_arr_atomic_fields             bitmap_atomic init_atomic;
+   #define sfd_arr_atomic_fields_init(name)  name.init_atomic.handle = 0;
+#else
+   #define sfd_arr_atomic_fields
+   #define sfd_arr_atomic_fields_init(name)
+#endif
+
 // CAN be used as expression
 #define sfd_flag_get(name) \
    (name.flags)
@@ -346,7 +400,9 @@ static int sfd_memset(void *str, int c, size_t n) {
       type* start;         \
       uint_fast32_t size;  \
       simple_bitmap init_map;\
-      map_block temp;      \
+      bitmap_handle init_handle;\
+      simple_sparse_bitmap init_sparse;\
+      sfd_arr_atomic_fields\
       type ret_temp;       \
       int (*constraint_ele) (type);    \
       char* con_in_effect_ele;         \
@@ -354,6 +410,13 @@ static int sfd_memset(void *str, int c, size_t n) {
       int (*constraint_arr) (int, ...);\
       char* con_in_effect_arr;         \
       char* con_expr_arr;              \
+      int (*constraint_inc_init) (type*, uint_fast32_t, long long*);\
+      int (*constraint_inc_update) (type, type, uint_fast32_t, long long*);\
+      long long con_state_arr;         \
+      int con_res_arr;                 \
+      type old_temp;                   \
+      uint_fast32_t dirty_lo;          \
+      uint_fast32_t dirty_hi;          \
    } name;\
    map_block name##_sfd_raw_init_map [get_bitmap_map_block_number(in_size)];\
    type name##_sfd_arr [in_size];\
@@ -361,8 +424,12 @@ static int sfd_memset(void *str, int c, size_t n) {
    name.start = name##_sfd_arr;\
    name.size = in_size;\
    bitmap_init(&name.init_map, name##_sfd_raw_init_map, NULL, in_size, 0);\
+   (void) sfd_arr_init_checkout(name);\
    name.constraint_ele = 0;\
-   name.constraint_arr = 0;
+   name.constraint_arr = 0;\
+   name.constraint_inc_init = 0;\
+   name.constraint_inc_update = 0;\
+   sfd_arr_atomic_fields_init(name)
 
 // can NOT be used as expression
 #define sfd_arr_dec_dyn(type, name, in_size)\
@@ -371,7 +438,9 @@ static int sfd_memset(void *str, int c, size_t n) {
       type* start;         \
       uint_fast32_t size;  \
       simple_bitmap init_map;\
-      map_block temp;      \
+      bitmap_handle init_handle;\
+      simple_sparse_bitmap init_sparse;\
+      sfd_arr_atomic_fields\
       type ret_temp;       \
       int (*constraint_ele) (type);    \
       char* con_in_effect_ele;         \
@@ -379,6 +448,13 @@ static int sfd_memset(void *str, int c, size_t n) {
       int (*constraint_arr) (int, ...);\
       char* con_in_effect_arr;         \
       char* con_expr_arr;              \
+      int (*constraint_inc_init) (type*, uint_fast32_t, long long*);\
+      int (*constraint_inc_update) (type, type, uint_fast32_t, long long*);\
+      long long con_state_arr;         \
+      int con_res_arr;                 \
+      type old_temp;                   \
+      uint_fast32_t dirty_lo;          \
+      uint_fast32_t dirty_hi;          \
    } name;\
    map_block* name##_sfd_raw_init_map = (map_block*) malloc(sizeof(map_block) * get_bitmap_map_block_number(in_size));\
    name.start = (type*) malloc(sizeof(type) * in_size);\
@@ -392,9 +468,13 @@ static int sfd_memset(void *str, int c, size_t n) {
       name.flags = SFD_FL_READ | SFD_FL_WRITE | SFD_FL_CON_ELE | SFD_FL_CON_ARR;\
       name.size = in_size;\
       bitmap_init(&name.init_map, name##_sfd_raw_init_map, NULL, in_size, 0);\
+      (void) sfd_arr_init_checkout(name);\
    }\
    name.constraint_ele = 0;\
-   name.constraint_arr = 0;
+   name.constraint_arr = 0;\
+   name.constraint_inc_init = 0;\
+   name.constraint_inc_update = 0;\
+   sfd_arr_atomic_fields_init(name)
 
 // can NOT be used as expression
 #define sfd_arr_dec_man(type, name, in_size, bmp_start, arr_start)\
@@ -403,7 +483,9 @@ static int sfd_memset(void *str, int c, size_t n) {
       type* start;         \
       uint_fast32_t size;  \
       simple_bitmap init_map;\
-      map_block temp;      \
+      bitmap_handle init_handle;\
+      simple_sparse_bitmap init_sparse;\
+      sfd_arr_atomic_fields\
       type ret_temp;       \
       int (*constraint_ele) (type);    \
       char* con_in_effect_ele;         \
@@ -411,13 +493,90 @@ static int sfd_memset(void *str, int c, size_t n) {
       int (*constraint_arr) (int, ...);\
       char* con_in_effect_arr;         \
       char* con_expr_arr;              \
+      int (*constraint_inc_init) (type*, uint_fast32_t, long long*);\
+      int (*constraint_inc_update) (type, type, uint_fast32_t, long long*);\
+      long long con_state_arr;         \
+      int con_res_arr;                 \
+      type old_temp;                   \
+      uint_fast32_t dirty_lo;          \
+      uint_fast32_t dirty_hi;          \
    } name;\
    name.flags = SFD_FL_READ | SFD_FL_WRITE | SFD_FL_CON_ELE | SFD_FL_CON_ARR;\
    name.start = arr_start;\
    name.size = in_size;\
    bitmap_init(&name.init_map, bmp_start, NULL, in_size, 0);\
+   (void) sfd_arr_init_checkout(name);\
+   name.constraint_ele = 0;\
+   name.constraint_arr = 0;\
+   name.constraint_inc_init = 0;\
+   name.constraint_inc_update = 0;\
+   sfd_arr_atomic_fields_init(name)
+
+// can NOT be used as expression
+/* same as sfd_arr_dec_dyn, but the initialisation of elements is tracked
+ * in a sparse bitmap(see bitmap_sparse_init) instead of a plain one,
+ * which takes far less memory when only a few elements are ever written
+ * 
+ * the array is released with free(name.start) and bitmap_sparse_free(&name.init_sparse)
+ */
+#define sfd_arr_dec_sparse(type, name, in_size)\
+   struct {\
+      uint_least16_t flags; \
+      type* start;         \
+      uint_fast32_t size;  \
+      simple_bitmap init_map;\
+      bitmap_handle init_handle;\
+      simple_sparse_bitmap init_sparse;\
+      sfd_arr_atomic_fields\
+      type ret_temp;       \
+      int (*constraint_ele) (type);    \
+      char* con_in_effect_ele;         \
+      char* con_expr_ele;              \
+      int (*constraint_arr) (int, ...);\
+      char* con_in_effect_arr;         \
+      char* con_expr_arr;              \
+      int (*constraint_inc_init) (type*, uint_fast32_t, long long*);\
+      int (*constraint_inc_update) (type, type, uint_fast32_t, long long*);\
+      long long con_state_arr;         \
+      int con_res_arr;                 \
+      type old_temp;                   \
+      uint_fast32_t dirty_lo;          \
+      uint_fast32_t dirty_hi;          \
+   } name;\
+   name.start = (type*) malloc(sizeof(type) * in_size);\
+   if (name.start == NULL || bitmap_sparse_init(&name.init_sparse, in_size, 0) != 0) {\
+      (void) (sfd_printf("sfd : sfd_arr_dec_sparse : malloc failed : file : %s, line : %d\n", __FILE__, __LINE__));\
+      name.flags = 0;\
+      name.size = 0;\
+      sfd_force_exit();\
+   }\
+   else {\
+      name.flags = SFD_FL_READ | SFD_FL_WRITE | SFD_FL_CON_ELE | SFD_FL_CON_ARR | SFD_FL_SPARSE;\
+      name.size = in_size;\
+   }\
    name.constraint_ele = 0;\
-   name.constraint_arr = 0;
+   name.constraint_arr = 0;\
+   name.constraint_inc_init = 0;\
+   name.constraint_inc_update = 0;\
+   sfd_arr_atomic_fields_init(name)
+
+// CAN be used as expression
+// INTERNAL USE, reads the initialisation bit of an element from whichever bitmap the array uses
+#define sfd_arr_init_read(name, indx) \
+   (name.flags & SFD_FL_SPARSE?\
+      bitmap_sparse_test(&name.init_sparse, indx)\
+   :\
+      sfd_arr_init_map_read(name, indx)\
+   )
+
+// CAN be used as expression
+// INTERNAL USE, marks an element as initialised
+#define sfd_arr_init_write(name, indx) \
+   (name.flags & SFD_FL_SPARSE?\
+      bitmap_sparse_write(&name.init_sparse, indx, 1)\
+   :\
+      sfd_arr_init_map_write(name, indx)\
+   )
 
 // CAN be used as expression
 #define sfd_arr_read(name, indx) \
@@ -428,13 +587,12 @@ static int sfd_memset(void *str, int c, size_t n) {
          (name.flags & SFD_FL_INITD? \
             (name.start[indx])\
          :\
-             0* bitmap_read(&name.init_map, indx, &name.temp, 0)\
-            +  (name.temp? \
-                  (name.start[indx])\
-               :\
-                   sfd_printf("sfd : Uninitialised read : file : %s, line : %d\n", __FILE__, __LINE__)\
-                  +sfd_force_exit()\
-               )\
+            (sfd_arr_init_read(name, indx)? \
+               (name.start[indx])\
+            :\
+                sfd_printf("sfd : Uninitialised read : file : %s, line : %d\n", __FILE__, __LINE__)\
+               +sfd_force_exit()\
+            )\
          )\
       :\
           sfd_printf("sfd : Index out of bound : file : %s, line : %d\n", __FILE__, __LINE__)\
@@ -447,14 +605,12 @@ static int sfd_memset(void *str, int c, size_t n) {
    )
 
 // CAN be used as expression
-#define sfd_arr_write(name, indx, in_val) \
+// INTERNAL USE, the checks after element indx was written, old_temp must hold its previous value
+#define sfd_arr_write_checks(name, indx) \
    (\
-   name.ret_temp =\
-   (name.flags & SFD_FL_WRITE? \
-      (indx < name.size? \
-          (name.start[indx] = in_val)\
-         +0* bitmap_write(&name.init_map, indx, 1, 0)\
-         +\
+      (name.flags & SFD_FL_BATCH?\
+         sfd_arr_batch_mark(name, indx)\
+      :\
          (name.flags & SFD_FL_CON_ELE?\
             (name.constraint_ele ?\
                sfd_arr_enforce_con_ele(name, name.start[indx])\
@@ -464,8 +620,12 @@ static int sfd_memset(void *str, int c, size_t n) {
          :\
             0\
          )\
-         +\
-         (name.flags & SFD_FL_CON_ARR?\
+      )\
+      +\
+      (name.constraint_inc_update ?\
+         sfd_arr_enforce_con_inc(name, indx)\
+      :\
+         (name.flags & SFD_FL_CON_ARR && !(name.flags & SFD_FL_BATCH)?\
             (name.constraint_arr ?\
                sfd_arr_enforce_con_arr(name)\
             :\
@@ -474,6 +634,22 @@ static int sfd_memset(void *str, int c, size_t n) {
          :\
             0\
          )\
+      )\
+   )
+
+// CAN be used as expression
+// the old value is captured, then the new one stored, then the checks run, in that order
+#define sfd_arr_write(name, indx, in_val) \
+   (\
+   name.ret_temp =\
+   (name.flags & SFD_FL_WRITE? \
+      (indx < name.size? \
+         (\
+          name.old_temp = name.start[indx],\
+          name.start[indx] = in_val,\
+          sfd_arr_init_write(name, indx),\
+          name.start[indx] + sfd_arr_write_checks(name, indx)\
+         )\
       :\
           sfd_printf("sfd : Index out of bound : file : %s, line : %d\n", __FILE__, __LINE__)\
          +sfd_force_exit()\
@@ -490,32 +666,15 @@ static int sfd_memset(void *str, int c, size_t n) {
    name.ret_temp =\
    (name.flags & SFD_FL_WRITE? \
       (indx < name.size? \
-          0* bitmap_read(&name.init_map, indx, &name.temp, 0)\
-         +  (name.temp? \
-               (name.start[indx] += in_val)\
-            :\
-                sfd_printf("sfd : Uninitialised incre : file : %s, line : %d\n", __FILE__, __LINE__)\
-               +sfd_force_exit()\
-            )\
-         +\
-         (name.flags & SFD_FL_CON_ELE?\
-            (name.constraint_ele ?\
-               sfd_arr_enforce_con_ele(name, name.start[indx])\
-            :\
-               0\
+         (sfd_arr_init_read(name, indx)? \
+            (\
+             name.old_temp = name.start[indx],\
+             name.start[indx] += in_val,\
+             name.start[indx] + sfd_arr_write_checks(name, indx)\
             )\
          :\
-            0\
-         )\
-         +\
-         (name.flags & SFD_FL_CON_ARR?\
-            (name.constraint_arr ?\
-               sfd_arr_enforce_con_arr(name)\
-            :\
-               0\
-            )\
-         :\
-            0\
+             sfd_printf("sfd : Uninitialised incre : file : %s, line : %d\n", __FILE__, __LINE__)\
+            +sfd_force_exit()\
          )\
       :\
           sfd_printf("sfd : Index out of bound : file : %s, line : %d\n", __FILE__, __LINE__)\
@@ -532,7 +691,12 @@ static int sfd_memset(void *str, int c, size_t n) {
    (\
    name.ret_temp =\
    (name.flags & SFD_FL_WRITE? \
-       (sfd_memset(name.start, 0, sizeof(name.start[0]) * name.size))\
+       (sfd_memset(name.start, 0, sizeof(name.start[0]) * name.size), sfd_arr_resync_con_inc(name), 0)\
+      +0* (name.flags & SFD_FL_SPARSE?\
+              bitmap_sparse_one(&name.init_sparse)\
+           :\
+              sfd_arr_init_map_one(name)\
+          )\
       +0* (name.flags |= SFD_FL_INITD)\
    :\
        sfd_printf("sfd : Write not permitted : file : %s, line : %d\n", __FILE__, __LINE__)\
@@ -540,6 +704,29 @@ static int sfd_memset(void *str, int c, size_t n) {
    )\
    )
 
+// CAN be used as expression
+// both from and to are inclusive
+#define sfd_arr_wipe_range(name, from, to) \
+   (\
+   name.ret_temp =\
+   (name.flags & SFD_FL_WRITE? \
+      ((from) <= (to) && (to) < name.size? \
+          (sfd_memset(name.start + (from), 0, sizeof(name.start[0]) * ((to) - (from) + 1)), sfd_arr_resync_con_inc(name), 0)\
+         +0* (name.flags & SFD_FL_SPARSE?\
+                 bitmap_sparse_write_range(&name.init_sparse, from, to, 1)\
+              :\
+                 bitmap_write_range(&name.init_map, from, to, 1, 0)\
+             )\
+      :\
+          sfd_printf("sfd : Index out of bound : file : %s, line : %d\n", __FILE__, __LINE__)\
+         +sfd_force_exit()\
+      )\
+   :\
+       sfd_printf("sfd : Write not permitted : file : %s, line : %d\n", __FILE__, __LINE__)\
+      +sfd_force_exit()\
+   )\
+   )
+
 // CAN be used as expression
 #define sfd_arr_enforce_con_ele(name, val) \
    (name.constraint_ele(val)? \
@@ -562,6 +749,187 @@ static int sfd_memset(void *str, int c, size_t n) {
       +sfd_force_exit()\
    )
 
+// CAN be used as expression
+// the state is always updated, the result is only checked if SFD_FL_CON_ARR is set and not in a batch
+#define sfd_arr_enforce_con_inc(name, indx) \
+   ((name.con_res_arr = name.constraint_inc_update(name.old_temp, name.start[indx], indx, &name.con_state_arr))\
+    || !(name.flags & SFD_FL_CON_ARR) || (name.flags & SFD_FL_BATCH)? \
+      0\
+   :\
+       sfd_printf("sfd : Constraint failed : file : %s, line : %d\n", __FILE__, __LINE__)\
+      +sfd_printf("        Constraint in effect  : %s\n", name.con_in_effect_arr)\
+      +sfd_printf("        Constraint expression : %s\n", name.con_expr_arr)\
+      +sfd_force_exit()\
+   )
+
+// CAN be used as expression
+// recomputes the state of an incremental constraint from the whole array, used after bulk writes
+#define sfd_arr_resync_con_inc(name) \
+   (name.constraint_inc_update ?\
+      (name.con_res_arr = name.constraint_inc_init(name.start, name.size, &name.con_state_arr))\
+   :\
+      0\
+   )
+
+// CAN be used as expression
+// INTERNAL USE, widens the dirty range of the current batch to cover indx
+#define sfd_arr_batch_mark(name, indx) \
+   (\
+      name.dirty_lo = ((uint_fast32_t) (indx) < name.dirty_lo ? (uint_fast32_t) (indx) : name.dirty_lo),\
+      name.dirty_hi = ((uint_fast32_t) (indx) > name.dirty_hi ? (uint_fast32_t) (indx) : name.dirty_hi),\
+      0\
+   )
+
+// CAN be used as expression
+/* batched constraint enforcement
+ *    between sfd_arr_batch_begin and sfd_arr_batch_end, writes and increments
+ *    do not check constraints, they only record the range of indices touched
+ *    
+ *    sfd_arr_batch_end then checks the element constraint over that range once,
+ *    and the array-wise constraint once, reporting with the location of sfd_arr_batch_end
+ *    
+ *    bound checks, permissions and initialisation tracking are not deferred
+ *    calling sfd_arr_batch_begin inside a batch has no effect
+ */
+#define sfd_arr_batch_begin(name) \
+   (name.flags & SFD_FL_BATCH?\
+      0\
+   :\
+       0* (name.dirty_lo = name.size)\
+      +0* (name.dirty_hi = 0)\
+      +0* (name.flags |= SFD_FL_BATCH)\
+   )
+
+// can NOT be used as expression
+#define sfd_arr_batch_end(name) \
+   if (name.flags & SFD_FL_BATCH) {\
+      uint_fast32_t sfd_batch_i;\
+      name.flags &= ~SFD_FL_BATCH;\
+      if (name.dirty_lo <= name.dirty_hi) {\
+         if (name.flags & SFD_FL_CON_ELE && name.constraint_ele) {\
+            for (sfd_batch_i = name.dirty_lo; sfd_batch_i <= name.dirty_hi; sfd_batch_i++) {\
+               /* elements in the range that were never written hold no value to check */\
+               if ((name.flags & SFD_FL_INITD || sfd_arr_init_read(name, sfd_batch_i))\
+                   && ! name.constraint_ele(name.start[sfd_batch_i])) {\
+                  (void) (sfd_printf("sfd : Constraint failed : file : %s, line : %d\n", __FILE__, __LINE__));\
+                  (void) (sfd_printf("        Constraint in effect  : %s\n", name.con_in_effect_ele));\
+                  (void) (sfd_printf("        Constraint expression : %s\n", name.con_expr_ele));\
+                  (void) (sfd_printf("        Index                 : %lu\n", (unsigned long) sfd_batch_i));\
+                  sfd_force_exit();\
+                  break;\
+               }\
+            }\
+         }\
+         if (name.flags & SFD_FL_CON_ARR\
+             && (name.constraint_inc_update ? !name.con_res_arr\
+                 : name.constraint_arr && !name.constraint_arr(0, name.start, name.size))) {\
+            (void) (sfd_printf("sfd : Constraint failed : file : %s, line : %d\n", __FILE__, __LINE__));\
+            (void) (sfd_printf("        Constraint in effect  : %s\n", name.con_in_effect_arr));\
+            (void) (sfd_printf("        Constraint expression : %s\n", name.con_expr_arr));\
+            sfd_force_exit();\
+         }\
+      }\
+   }
+
+#ifdef SIMPLE_BITMAP_ATOMIC
+// CAN be used as expression
+/* concurrent writers
+ *    between sfd_arr_atomic_begin and sfd_arr_atomic_end, any number of threads may
+ *    use sfd_arr_write_mt and sfd_arr_read_mt on the same array without a lock,
+ *    the initialisation bits are then set with atomic operations
+ *    
+ *    sfd_arr_write_mt checks the element constraint on every write as usual,
+ *    but the array-wise constraint is only checked once by sfd_arr_atomic_end
+ *    
+ *    sfd_arr_write_mt evaluates to 0 rather than the value written
+ *    
+ *    all other sfd_arr_* macros are NOT thread safe, and must not be used
+ *    while other threads are writing
+ *    
+ *    requires SIMPLE_BITMAP_ATOMIC, and is not available to arrays declared by sfd_arr_dec_sparse
+ */
+#define sfd_arr_atomic_begin(name) \
+   (name.flags & SFD_FL_SPARSE?\
+       sfd_printf("sfd : Sparse array can not be in atomic mode : file : %s, line : %d\n", __FILE__, __LINE__)\
+      +sfd_force_exit()\
+   :\
+      (name.init_atomic.handle?\
+         0\
+      :\
+         ((void) sfd_arr_atomic_checkout(name), bitmap_atomic_begin(&name.init_handle, &name.init_atomic))\
+      )\
+   )
+
+// can NOT be used as expression
+// must only be used once all writing threads are done
+#define sfd_arr_atomic_end(name) \
+   if (name.init_atomic.handle) {\
+      bitmap_atomic_end(&name.init_atomic);\
+      (void) sfd_arr_atomic_release(name);\
+      sfd_arr_resync_con_inc(name);\
+      if (name.flags & SFD_FL_CON_ARR\
+          && (name.constraint_inc_update ? !name.con_res_arr\
+              : name.constraint_arr && !name.constraint_arr(0, name.start, name.size))) {\
+         (void) (sfd_printf("sfd : Constraint failed : file : %s, line : %d\n", __FILE__, __LINE__));\
+         (void) (sfd_printf("        Constraint in effect  : %s\n", name.con_in_effect_arr));\
+         (void) (sfd_printf("        Constraint expression : %s\n", name.con_expr_arr));\
+         sfd_force_exit();\
+      }\
+   }
+
+// CAN be used as expression
+#define sfd_arr_read_mt(name, indx) \
+   (name.flags & SFD_FL_READ? \
+      (indx < name.size? \
+         (name.init_atomic.handle? \
+            (name.flags & SFD_FL_INITD || bitmap_atomic_read(&name.init_atomic, indx)? \
+               (name.start[indx])\
+            :\
+                sfd_printf("sfd : Uninitialised read : file : %s, line : %d\n", __FILE__, __LINE__)\
+               +sfd_force_exit()\
+            )\
+         :\
+             sfd_printf("sfd : Array not in atomic mode : file : %s, line : %d\n", __FILE__, __LINE__)\
+            +sfd_force_exit()\
+         )\
+      :\
+          sfd_printf("sfd : Index out of bound : file : %s, line : %d\n", __FILE__, __LINE__)\
+         +sfd_force_exit()\
+      )\
+   :\
+       sfd_printf("sfd : Read not permitted : file : %s, line : %d\n", __FILE__, __LINE__)\
+      +sfd_force_exit()\
+   )
+
+// CAN be used as expression
+// the element is stored before its initialisation bit is set,
+// so a thread that sees the bit set also sees the element
+#define sfd_arr_write_mt(name, indx, in_val) \
+   (name.flags & SFD_FL_WRITE? \
+      (indx < name.size? \
+         (name.init_atomic.handle? \
+            (name.start[indx] = in_val,\
+             bitmap_atomic_test_and_set(&name.init_atomic, indx),\
+               (name.flags & SFD_FL_CON_ELE && name.constraint_ele?\
+                  sfd_arr_enforce_con_ele(name, name.start[indx])\
+               :\
+                  0\
+               )\
+            )\
+         :\
+             sfd_printf("sfd : Array not in atomic mode : file : %s, line : %d\n", __FILE__, __LINE__)\
+            +sfd_force_exit()\
+         )\
+      :\
+          sfd_printf("sfd : Index out of bound : file : %s, line : %d\n", __FILE__, __LINE__)\
+         +sfd_force_exit()\
+      )\
+   :\
+       sfd_printf("sfd : Write not permitted : file : %s, line : %d\n", __FILE__, __LINE__)\
+      +sfd_force_exit()\
+   )
+#endif
+
 // can NOT be used as expression
 #define sfd_arr_def_con_ele(con_name, type, arg_name, expr) \
    int sfd_con_##con_name##_per_element (type arg_name) {\
@@ -581,6 +949,22 @@ static int sfd_memset(void *str, int c, size_t n) {
       }\
       return 1;\
    }\
+   int sfd_con_##con_name##_inc_init (type* start, uint_fast32_t size, long long* state) {\
+      uint_fast32_t i;\
+      *state = 0;\
+      for (i = 0; i < size; i++) {\
+         if ( ! sfd_con_##con_name##_per_element(start[i])) {\
+            (*state)++;\
+         }\
+      }\
+      return *state == 0;\
+   }\
+   int sfd_con_##con_name##_inc_update (type old_val, type new_val, uint_fast32_t index, long long* state) {\
+      (void) index;\
+      *state += ! sfd_con_##con_name##_per_element(new_val);\
+      *state -= ! sfd_con_##con_name##_per_element(old_val);\
+      return *state == 0;\
+   }\
    char* sfd_con_##con_name##_arr_expr = #expr;
 
 // can NOT be used as expression
@@ -596,22 +980,53 @@ static int sfd_memset(void *str, int c, size_t n) {
    char* sfd_con_##con_name##_arr_expr = #func_name;
 
 // can NOT be used as expression
+/* incremental array-wise constraint
+ *    instead of checking the whole array after every write,
+ *    the constraint keeps a running state which is updated per element written
+ * 
+ *    init_func   : int init_func (type* start, uint_fast32_t size, long long* state)
+ *       computes the state from the whole array,
+ *       called when the constraint is added and after sfd_arr_wipe/sfd_arr_wipe_range
+ *    update_func : int update_func (type old_val, type new_val, uint_fast32_t index, long long* state)
+ *       updates the state after element index changed from old_val to new_val
+ *    both return non-zero if the constraint holds
+ */
+#define sfd_arr_def_con_inc(con_name, type, init_func, update_func) \
+   int sfd_con_##con_name##_inc_init (type* start, uint_fast32_t size, long long* state) {\
+      return init_func(start, size, state);\
+   }\
+   int sfd_con_##con_name##_inc_update (type old_val, type new_val, uint_fast32_t index, long long* state) {\
+      return update_func(old_val, new_val, index, state);\
+   }\
+   char* sfd_con_##con_name##_arr_expr = #update_func;
+
+// can NOT be used as expression
+// the array-wise form keeps a count of violating elements, so each write costs O(1)
 #define sfd_arr_add_con_ele(name, con_name, arr_wise) \
    name.constraint_ele     = &sfd_con_##con_name##_per_element;\
    name.con_in_effect_ele  = #con_name;                        \
    name.con_expr_ele       = sfd_con_##con_name##_arr_expr;    \
    if (arr_wise) {\
-      name.constraint_arr     = &sfd_con_##con_name##_arr_loop;\
-      name.con_in_effect_arr  = #con_name;                     \
-      name.con_expr_arr       = sfd_con_##con_name##_arr_expr; \
+      sfd_arr_add_con_inc(name, con_name);\
    }
 
 // can NOT be used as expression
 #define sfd_arr_add_con_arr(name, con_name) \
    name.constraint_arr     = &sfd_con_##con_name##_array_wise;\
+   name.constraint_inc_init   = 0;\
+   name.constraint_inc_update = 0;\
    name.con_in_effect_arr  = #con_name;\
    name.con_expr_arr       = sfd_con_##con_name##_arr_expr;
 
+// can NOT be used as expression
+#define sfd_arr_add_con_inc(name, con_name) \
+   name.constraint_arr        = 0;\
+   name.constraint_inc_init   = &sfd_con_##con_name##_inc_init;\
+   name.constraint_inc_update = &sfd_con_##con_name##_inc_update;\
+   name.con_in_effect_arr     = #con_name;\
+   name.con_expr_arr          = sfd_con_##con_name##_arr_expr;\
+   name.con_res_arr = name.constraint_inc_init(name.start, name.size, &name.con_state_arr);
+
 // CAN be used as expression
 #define sfd_arr_get_size(name) \
    (name.size)